@@ -0,0 +1,70 @@
+#include "colorKernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLOR_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+template <typename T>
+static inline void colorScalar(const T *iters, int count, const uint32_t *lut, unsigned int last, uint32_t *out) {
+    for (int i=0; i<count; i++) {
+        unsigned int iter = iters[i];
+        out[i] = lut[iter < last ? iter : last];
+    }
+}
+
+void colorKernelScalar(const void *iters, bool compact, int count,
+                       const uint32_t *lut, unsigned int last, uint32_t *out) {
+    if (compact) colorScalar((const uint16_t *) iters, count, lut, last, out);
+    else colorScalar((const uint32_t *) iters, count, lut, last, out);
+}
+
+#ifdef COLOR_KERNEL_X86
+
+__attribute__((target("avx2")))
+static void colorKernelAVX2(const void *iters, bool compact, int count,
+                            const uint32_t *lut, unsigned int last, uint32_t *out) {
+    const __m256i limit = _mm256_set1_epi32(last);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i index;
+        if (compact) index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) ((const uint16_t *) iters + i)));
+        else index = _mm256_loadu_si256((const __m256i *) ((const uint32_t *) iters + i));
+        index = _mm256_min_epu32(index, limit);
+        __m256i color = _mm256_i32gather_epi32((const int *) lut, index, 4);
+        _mm256_storeu_si256((__m256i *) (out + i), color);
+    }
+    if (compact) colorScalar((const uint16_t *) iters + i, count - i, lut, last, out + i);
+    else colorScalar((const uint32_t *) iters + i, count - i, lut, last, out + i);
+}
+
+__attribute__((target("avx512f")))
+static void colorKernelAVX512(const void *iters, bool compact, int count,
+                              const uint32_t *lut, unsigned int last, uint32_t *out) {
+    //the masked forms, with every lane on, because the plain ones make gcc warn
+    //about the undefined vectors inside them
+    const __mmask16 all = 0xFFFF;
+    const __m512i limit = _mm512_set1_epi32(last);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i index;
+        if (compact) index = _mm512_maskz_cvtepu16_epi32(all, _mm256_loadu_si256((const __m256i *) ((const uint16_t *) iters + i)));
+        else index = _mm512_loadu_si512((const void *) ((const uint32_t *) iters + i));
+        index = _mm512_maskz_min_epu32(all, index, limit);
+        __m512i color = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), all, index, (const void *) lut, 4);
+        _mm512_storeu_si512((void *) (out + i), color);
+    }
+    if (compact) colorScalar((const uint16_t *) iters + i, count - i, lut, last, out + i);
+    else colorScalar((const uint32_t *) iters + i, count - i, lut, last, out + i);
+}
+
+#endif
+
+ColorKernel selectColorKernel() {
+#ifdef COLOR_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return colorKernelAVX512;
+    if (__builtin_cpu_supports("avx2")) return colorKernelAVX2;
+#endif
+    return colorKernelScalar;
+}
@@ -0,0 +1,22 @@
+#ifndef COLORKERNEL_H
+#define COLORKERNEL_H
+
+#include <stdint.h>
+
+//The color kernels turn a row of escape-times into RGBA pixels through a lookup
+//table: out[i] = lut[min(iters[i], last)]. The table has one packed RGBA color
+//for every count from 0 to last, so coloring is one load per pixel instead of a
+//palette calculation. iters are 16 bit if compact (like a compact
+//IterationBuffer) and 32 bit otherwise. The wide kernels look up 8 (AVX2) or 16
+//(AVX-512) pixels at a time with gathers.
+typedef void (*ColorKernel)(const void *iters, bool compact, int count,
+                            const uint32_t *lut, unsigned int last, uint32_t *out);
+
+//plain one-pixel-at-a-time version, works everywhere
+void colorKernelScalar(const void *iters, bool compact, int count,
+                       const uint32_t *lut, unsigned int last, uint32_t *out);
+
+//returns the widest kernel the current CPU supports (checked with CPUID)
+ColorKernel selectColorKernel();
+
+#endif
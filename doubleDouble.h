@@ -0,0 +1,101 @@
+#ifndef DOUBLEDOUBLE_H
+#define DOUBLEDOUBLE_H
+
+//DoubleDouble is an unevaluated sum of two doubles, hi + lo, which gives about
+//106 bits of precision using nothing but double arithmetic. It is the middle
+//precision tier: much slower than a double, but much faster than HighPrecision.
+//
+//All of it relies on every operation being rounded on its own, so it has to be
+//built without floating point contraction (-ffp-contract=off) or -ffast-math.
+struct DoubleDouble {
+    double hi;
+    double lo;
+
+    DoubleDouble() : hi(0), lo(0) {}
+    DoubleDouble(double value) : hi(value), lo(0) {}
+    DoubleDouble(double h, double l) : hi(h), lo(l) {}
+
+    double toDouble() const {return hi + lo;}
+};
+
+//The building blocks are templates so the SIMD kernels can run them on whole
+//vectors of doubles (T is then a GCC vector type). They take and return through
+//references so vectors never get passed by value between ISAs.
+
+//error free transformations: the exact result is s + e. The outputs are only
+//written at the end, so they can be the same variables as the inputs
+template <typename T>
+inline void twoSum(const T &a, const T &b, T &s, T &e) {
+    T sum = a + b;
+    T bb = sum - a;
+    e = (a - (sum - bb)) + (b - bb);
+    s = sum;
+}
+//only valid when |a| >= |b|
+template <typename T>
+inline void quickTwoSum(const T &a, const T &b, T &s, T &e) {
+    T sum = a + b;
+    e = b - (sum - a);
+    s = sum;
+}
+//Dekker's product: split both numbers in halves that multiply exactly
+template <typename T>
+inline void twoProd(const T &a, const T &b, T &p, T &e) {
+    T product = a * b;
+    T t = 134217729.0 * a; //2^27 + 1
+    T a_hi = t - (t - a), a_lo = a - a_hi;
+    t = 134217729.0 * b;
+    T b_hi = t - (t - b), b_lo = b - b_hi;
+    e = ((a_hi*b_hi - product) + a_hi*b_lo + a_lo*b_hi) + a_lo*b_lo;
+    p = product;
+}
+//(rh, rl) = (ah, al) + (bh, bl)
+template <typename T>
+inline void addDoubleDouble(const T &ah, const T &al, const T &bh, const T &bl, T &rh, T &rl) {
+    T sh, sl, th, tl;
+    twoSum(ah, bh, sh, sl);
+    twoSum(al, bl, th, tl);
+    quickTwoSum(sh, T(sl + th), sh, sl);
+    quickTwoSum(sh, T(sl + tl), rh, rl);
+}
+//(rh, rl) = (ah, al) * (bh, bl)
+template <typename T>
+inline void mulDoubleDouble(const T &ah, const T &al, const T &bh, const T &bl, T &rh, T &rl) {
+    T ph, pl;
+    twoProd(ah, bh, ph, pl);
+    quickTwoSum(ph, T(pl + (ah*bl + al*bh)), rh, rl);
+}
+
+inline DoubleDouble twoProd(double a, double b) {
+    DoubleDouble r;
+    twoProd(a, b, r.hi, r.lo);
+    return r;
+}
+inline DoubleDouble operator-(const DoubleDouble &a) {
+    return DoubleDouble(-a.hi, -a.lo);
+}
+inline DoubleDouble operator+(const DoubleDouble &a, const DoubleDouble &b) {
+    DoubleDouble r;
+    addDoubleDouble(a.hi, a.lo, b.hi, b.lo, r.hi, r.lo);
+    return r;
+}
+inline DoubleDouble operator-(const DoubleDouble &a, const DoubleDouble &b) {
+    return a + (-b);
+}
+inline DoubleDouble operator*(const DoubleDouble &a, const DoubleDouble &b) {
+    DoubleDouble r;
+    mulDoubleDouble(a.hi, a.lo, b.hi, b.lo, r.hi, r.lo);
+    return r;
+}
+inline DoubleDouble operator/(const DoubleDouble &a, double b) {
+    //one correction step on top of the double division
+    double q = a.hi / b;
+    DoubleDouble r = a - twoProd(q, b);
+    DoubleDouble result;
+    quickTwoSum(q, r.hi / b, result.hi, result.lo);
+    return result;
+}
+inline DoubleDouble &operator+=(DoubleDouble &a, const DoubleDouble &b) {return a = a + b;}
+inline DoubleDouble &operator-=(DoubleDouble &a, const DoubleDouble &b) {return a = a - b;}
+
+#endif
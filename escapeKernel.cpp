@@ -0,0 +1,428 @@
+#include "escapeKernel.h"
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ESCAPE_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+//how far inside the exact shapes a point has to be to skip iterating
+static const double interior_margin = 1e-12;
+
+//true if c is inside the main cardioid or the period-2 bulb, which never escape.
+//Both shapes are shrunk by a margin, so points right on their edges (which can
+//take a huge number of iterations to make up their mind) are still iterated
+static inline bool insideMainBody(double x, double y) {
+    double y_square = y*y;
+    double xq = x - 0.25;
+    double q = xq*xq + y_square;
+    if (q * (q + xq) < 0.25 * y_square - interior_margin) return true;
+    double xb = x + 1.0;
+    return xb*xb + y_square < 0.0625 - interior_margin;
+}
+
+//this is a specialized version of z = z^2 + c. It only does three multiplications,
+//instead of the normal six. The wide kernels below copy it operation for operation
+void escapeKernelScalar(const double *cx, const double *cy, double *zx, double *zy,
+                        unsigned int *iters, int count, unsigned int max_iter,
+                        bool check_interior) {
+    for (int i=0; i<count; i++) {
+        if (check_interior && insideMainBody(cx[i], cy[i])) {
+            iters[i] = max_iter;
+            zx[i] = zy[i] = NAN;
+            continue;
+        }
+
+        double x = zx[i], y = zy[i];
+        double x_square = x*x;
+        double y_square = y*y;
+        unsigned int iter = iters[i];
+        bool periodic = false;
+
+        //Brent's cycle detection: z is compared to a saved value, which moves up to
+        //the current z every time the steps since it was saved reach a power of two
+        double saved_x = x, saved_y = y;
+        unsigned int steps = 0, period = 1;
+
+        for (; iter < max_iter; iter++) {
+            y = x * y;
+            y += y; //multiply by two
+            y += cy[i];
+            x = x_square - y_square + cx[i];
+
+            x_square = x*x;
+            y_square = y*y;
+
+            //if the magnitude is greater than 2, it will escape
+            if (x_square + y_square > 4.0) break;
+
+            if (check_interior) {
+                //an exact repeat means the orbit cycles forever and never escapes
+                if (x == saved_x && y == saved_y) {
+                    periodic = true;
+                    break;
+                }
+                if (++steps == period) {
+                    saved_x = x;
+                    saved_y = y;
+                    steps = 0;
+                    period *= 2;
+                }
+            }
+        }
+
+        //keep the orbit of points that didn't escape so they can be continued.
+        //Points caught in a cycle didn't get to max_iter, so they have no orbit
+        if (periodic) {
+            iter = max_iter;
+            x = y = NAN;
+        }
+        if (iter >= max_iter) {
+            zx[i] = x;
+            zy[i] = y;
+        }
+        iters[i] = iter;
+    }
+}
+
+void escapeKernelDoubleDouble(const DoubleDouble *cx, const DoubleDouble *cy,
+                              unsigned int *iters, int count, unsigned int max_iter) {
+    for (int i=0; i<count; i++) {
+        DoubleDouble x, y;
+        DoubleDouble x_square, y_square;
+        unsigned int iter = 0;
+
+        for (; iter < max_iter; iter++) {
+            y = x * y;
+            y += y; //multiply by two
+            y += cy[i];
+            x = x_square - y_square + cx[i];
+
+            x_square = x*x;
+            y_square = y*y;
+
+            //the low parts can't change the answer to this comparison
+            if (x_square.hi + y_square.hi > 4.0) break;
+        }
+        iters[i] = iter;
+    }
+}
+
+#ifdef ESCAPE_KERNEL_X86
+
+//points used to pad a partial batch: c = 4 escapes on the first iteration
+static const double pad_x = 4.0;
+static const double pad_y = 0.0;
+
+__attribute__((target("avx2")))
+static void escapeKernelAVX2(const double *cx, const double *cy, double *zx, double *zy,
+                             unsigned int *iters, int count, unsigned int max_iter,
+                             bool check_interior) {
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d max = _mm256_set1_pd((double) max_iter);
+    const __m256d nan = _mm256_set1_pd(NAN);
+
+    for (int i=0; i<count; i+=4) {
+        //load the next four points, padding the last batch if needed
+        int lanes = count - i < 4 ? count - i : 4;
+        double bx[4] = {pad_x, pad_x, pad_x, pad_x};
+        double by[4] = {pad_y, pad_y, pad_y, pad_y};
+        double bzx[4] = {0, 0, 0, 0};
+        double bzy[4] = {0, 0, 0, 0};
+        double biter[4] = {0, 0, 0, 0};
+        for (int l=0; l<lanes; l++) {
+            bx[l] = cx[i+l];
+            by[l] = cy[i+l];
+            bzx[l] = zx[i+l];
+            bzy[l] = zy[i+l];
+            biter[l] = iters[i+l];
+        }
+        __m256d px = _mm256_loadu_pd(bx);
+        __m256d py = _mm256_loadu_pd(by);
+
+        __m256d x = _mm256_loadu_pd(bzx);
+        __m256d y = _mm256_loadu_pd(bzy);
+        __m256d x_square = _mm256_mul_pd(x, x);
+        __m256d y_square = _mm256_mul_pd(y, y);
+        __m256d final_x = x;
+        __m256d final_y = y;
+
+        //every lane counts its own iterations, and stops counting when it either
+        //escapes or reaches max_iter. The count it stops at is its escape-time
+        __m256d iter = _mm256_loadu_pd(biter);
+        __m256d active = _mm256_cmp_pd(iter, max, _CMP_LT_OQ);
+
+        if (check_interior) {
+            //the same test as insideMainBody, on all four lanes
+            const __m256d margin = _mm256_set1_pd(interior_margin);
+            __m256d py_square = _mm256_mul_pd(py, py);
+            __m256d xq = _mm256_sub_pd(px, _mm256_set1_pd(0.25));
+            __m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), py_square);
+            __m256d cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)),
+                _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(0.25), py_square), margin), _CMP_LT_OQ);
+            __m256d xb = _mm256_add_pd(px, one);
+            __m256d bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(xb, xb), py_square),
+                _mm256_sub_pd(_mm256_set1_pd(0.0625), margin), _CMP_LT_OQ);
+            __m256d inside = _mm256_or_pd(cardioid, bulb);
+            iter = _mm256_blendv_pd(iter, max, inside);
+            final_x = _mm256_blendv_pd(final_x, nan, inside);
+            final_y = _mm256_blendv_pd(final_y, nan, inside);
+            active = _mm256_andnot_pd(inside, active);
+        }
+
+        __m256d saved_x = x, saved_y = y;
+        unsigned int steps = 0, period = 1;
+
+        while (_mm256_movemask_pd(active) != 0) {
+            y = _mm256_mul_pd(x, y);
+            y = _mm256_add_pd(y, y);
+            y = _mm256_add_pd(y, py);
+            x = _mm256_add_pd(_mm256_sub_pd(x_square, y_square), px);
+
+            x_square = _mm256_mul_pd(x, x);
+            y_square = _mm256_mul_pd(y, y);
+
+            __m256d escaped = _mm256_cmp_pd(_mm256_add_pd(x_square, y_square), four, _CMP_GT_OQ);
+            active = _mm256_andnot_pd(escaped, active);
+
+            //Brent's cycle detection, with one shared step count for all lanes
+            if (check_interior) {
+                __m256d periodic = _mm256_and_pd(active, _mm256_and_pd(
+                    _mm256_cmp_pd(x, saved_x, _CMP_EQ_OQ), _mm256_cmp_pd(y, saved_y, _CMP_EQ_OQ)));
+                if (_mm256_movemask_pd(periodic) != 0) {
+                    iter = _mm256_blendv_pd(iter, max, periodic);
+                    final_x = _mm256_blendv_pd(final_x, nan, periodic);
+                    final_y = _mm256_blendv_pd(final_y, nan, periodic);
+                    active = _mm256_andnot_pd(periodic, active);
+                }
+                if (++steps == period) {
+                    saved_x = x;
+                    saved_y = y;
+                    steps = 0;
+                    period *= 2;
+                }
+            }
+
+            iter = _mm256_add_pd(iter, _mm256_and_pd(active, one));
+
+            //save the orbit of lanes that just reached max_iter
+            __m256d capped = _mm256_and_pd(active, _mm256_cmp_pd(iter, max, _CMP_GE_OQ));
+            if (_mm256_movemask_pd(capped) != 0) {
+                final_x = _mm256_blendv_pd(final_x, x, capped);
+                final_y = _mm256_blendv_pd(final_y, y, capped);
+                active = _mm256_andnot_pd(capped, active);
+            }
+        }
+
+        _mm256_storeu_pd(bzx, final_x);
+        _mm256_storeu_pd(bzy, final_y);
+        _mm256_storeu_pd(biter, iter);
+        for (int l=0; l<lanes; l++) {
+            iters[i+l] = (unsigned int) biter[l];
+            if (iters[i+l] >= max_iter) {
+                zx[i+l] = bzx[l];
+                zy[i+l] = bzy[l];
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void escapeKernelAVX512(const double *cx, const double *cy, double *zx, double *zy,
+                               unsigned int *iters, int count, unsigned int max_iter,
+                               bool check_interior) {
+    const __m512d four = _mm512_set1_pd(4.0);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d max = _mm512_set1_pd((double) max_iter);
+    const __m512d nan = _mm512_set1_pd(NAN);
+
+    for (int i=0; i<count; i+=8) {
+        //load the next eight points, padding the last batch if needed
+        int lanes = count - i < 8 ? count - i : 8;
+        __mmask8 load = (__mmask8) ((1u << lanes) - 1);
+        __m512d px = _mm512_mask_loadu_pd(_mm512_set1_pd(pad_x), load, cx + i);
+        __m512d py = _mm512_mask_loadu_pd(_mm512_set1_pd(pad_y), load, cy + i);
+        double biter[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        for (int l=0; l<lanes; l++) {
+            biter[l] = iters[i+l];
+        }
+
+        __m512d x = _mm512_maskz_loadu_pd(load, zx + i);
+        __m512d y = _mm512_maskz_loadu_pd(load, zy + i);
+        __m512d x_square = _mm512_mul_pd(x, x);
+        __m512d y_square = _mm512_mul_pd(y, y);
+        __m512d final_x = x;
+        __m512d final_y = y;
+
+        __m512d iter = _mm512_loadu_pd(biter);
+        __mmask8 active = _mm512_cmp_pd_mask(iter, max, _CMP_LT_OQ);
+
+        if (check_interior) {
+            //the same test as insideMainBody, on all eight lanes
+            const __m512d margin = _mm512_set1_pd(interior_margin);
+            __m512d py_square = _mm512_mul_pd(py, py);
+            __m512d xq = _mm512_sub_pd(px, _mm512_set1_pd(0.25));
+            __m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), py_square);
+            __mmask8 cardioid = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)),
+                _mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(0.25), py_square), margin), _CMP_LT_OQ);
+            __m512d xb = _mm512_add_pd(px, one);
+            __mmask8 bulb = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(xb, xb), py_square),
+                _mm512_sub_pd(_mm512_set1_pd(0.0625), margin), _CMP_LT_OQ);
+            __mmask8 inside = cardioid | bulb;
+            iter = _mm512_mask_blend_pd(inside, iter, max);
+            final_x = _mm512_mask_blend_pd(inside, final_x, nan);
+            final_y = _mm512_mask_blend_pd(inside, final_y, nan);
+            active &= (__mmask8) ~inside;
+        }
+
+        __m512d saved_x = x, saved_y = y;
+        unsigned int steps = 0, period = 1;
+
+        while (active != 0) {
+            y = _mm512_mul_pd(x, y);
+            y = _mm512_add_pd(y, y);
+            y = _mm512_add_pd(y, py);
+            x = _mm512_add_pd(_mm512_sub_pd(x_square, y_square), px);
+
+            x_square = _mm512_mul_pd(x, x);
+            y_square = _mm512_mul_pd(y, y);
+
+            __mmask8 escaped = _mm512_cmp_pd_mask(_mm512_add_pd(x_square, y_square), four, _CMP_GT_OQ);
+            active &= (__mmask8) ~escaped;
+
+            //Brent's cycle detection, with one shared step count for all lanes
+            if (check_interior) {
+                __mmask8 periodic = _mm512_mask_cmp_pd_mask(active, x, saved_x, _CMP_EQ_OQ) &
+                                    _mm512_cmp_pd_mask(y, saved_y, _CMP_EQ_OQ);
+                if (periodic != 0) {
+                    iter = _mm512_mask_blend_pd(periodic, iter, max);
+                    final_x = _mm512_mask_blend_pd(periodic, final_x, nan);
+                    final_y = _mm512_mask_blend_pd(periodic, final_y, nan);
+                    active &= (__mmask8) ~periodic;
+                }
+                if (++steps == period) {
+                    saved_x = x;
+                    saved_y = y;
+                    steps = 0;
+                    period *= 2;
+                }
+            }
+
+            iter = _mm512_mask_add_pd(iter, active, iter, one);
+
+            //save the orbit of lanes that just reached max_iter
+            __mmask8 capped = _mm512_mask_cmp_pd_mask(active, iter, max, _CMP_GE_OQ);
+            if (capped != 0) {
+                final_x = _mm512_mask_blend_pd(capped, final_x, x);
+                final_y = _mm512_mask_blend_pd(capped, final_y, y);
+                active &= (__mmask8) ~capped;
+            }
+        }
+
+        __mmask8 done = _mm512_mask_cmp_pd_mask(load, iter, max, _CMP_GE_OQ);
+        _mm512_mask_storeu_pd(zx + i, done, final_x);
+        _mm512_mask_storeu_pd(zy + i, done, final_y);
+        _mm512_storeu_pd(biter, iter);
+        for (int l=0; l<lanes; l++) {
+            iters[i+l] = (unsigned int) biter[l];
+        }
+    }
+}
+
+typedef double v4d __attribute__((vector_size(32)));
+typedef long long v4l __attribute__((vector_size(32)));
+typedef double v8d __attribute__((vector_size(64)));
+typedef long long v8l __attribute__((vector_size(64)));
+
+//the double-double loop over N lanes at once, written with GCC vector types so
+//the double-double building blocks can be shared with the scalar code. V is a
+//vector of N doubles and M the vector of 64 bit masks that comparing them gives
+template <typename V, typename M, int N>
+static inline __attribute__((always_inline))
+void escapeDoubleDoubleLanes(const DoubleDouble *cx, const DoubleDouble *cy,
+                             unsigned int *iters, int count, unsigned int max_iter) {
+    for (int i=0; i<count; i+=N) {
+        //load the next N points, padding the last batch if needed
+        int lanes = count - i < N ? count - i : N;
+        V cx_hi, cx_lo, cy_hi, cy_lo;
+        for (int l=0; l<N; l++) {
+            cx_hi[l] = l < lanes ? cx[i+l].hi : pad_x;
+            cx_lo[l] = l < lanes ? cx[i+l].lo : 0;
+            cy_hi[l] = l < lanes ? cy[i+l].hi : pad_y;
+            cy_lo[l] = l < lanes ? cy[i+l].lo : 0;
+        }
+
+        V zero = cx_hi - cx_hi;
+        V x_hi = zero, x_lo = zero, y_hi = zero, y_lo = zero;
+        V x_square_hi = zero, x_square_lo = zero, y_square_hi = zero, y_square_lo = zero;
+        V t_hi, t_lo;
+
+        M active = (M) (zero == zero);
+        M result = (M) (zero == zero) & (long long) max_iter;
+
+        for (unsigned int iter = 0; iter < max_iter; iter++) {
+            mulDoubleDouble(x_hi, x_lo, y_hi, y_lo, y_hi, y_lo);
+            addDoubleDouble(y_hi, y_lo, y_hi, y_lo, y_hi, y_lo); //multiply by two
+            addDoubleDouble(y_hi, y_lo, cy_hi, cy_lo, y_hi, y_lo);
+            addDoubleDouble(x_square_hi, x_square_lo, V(-y_square_hi), V(-y_square_lo), t_hi, t_lo);
+            addDoubleDouble(t_hi, t_lo, cx_hi, cx_lo, x_hi, x_lo);
+
+            mulDoubleDouble(x_hi, x_lo, x_hi, x_lo, x_square_hi, x_square_lo);
+            mulDoubleDouble(y_hi, y_lo, y_hi, y_lo, y_square_hi, y_square_lo);
+
+            M escaped = (M) (x_square_hi + y_square_hi > 4.0) & active;
+            result = (result & ~escaped) | (escaped & (long long) iter);
+            active &= ~escaped;
+
+            //stop as soon as every lane has escaped
+            long long any = 0;
+            for (int l=0; l<N; l++) any |= active[l];
+            if (any == 0) break;
+        }
+
+        for (int l=0; l<lanes; l++) {
+            iters[i+l] = (unsigned int) result[l];
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void escapeKernelDoubleDoubleAVX2(const DoubleDouble *cx, const DoubleDouble *cy,
+                                         unsigned int *iters, int count, unsigned int max_iter) {
+    escapeDoubleDoubleLanes<v4d, v4l, 4>(cx, cy, iters, count, max_iter);
+}
+
+__attribute__((target("avx512f")))
+static void escapeKernelDoubleDoubleAVX512(const DoubleDouble *cx, const DoubleDouble *cy,
+                                           unsigned int *iters, int count, unsigned int max_iter) {
+    escapeDoubleDoubleLanes<v8d, v8l, 8>(cx, cy, iters, count, max_iter);
+}
+
+#endif
+
+DoubleDoubleKernel selectDoubleDoubleKernel() {
+#ifdef ESCAPE_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return escapeKernelDoubleDoubleAVX512;
+    if (__builtin_cpu_supports("avx2")) return escapeKernelDoubleDoubleAVX2;
+#endif
+    return escapeKernelDoubleDouble;
+}
+
+EscapeKernel selectEscapeKernel() {
+#ifdef ESCAPE_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return escapeKernelAVX512;
+    if (__builtin_cpu_supports("avx2")) return escapeKernelAVX2;
+#endif
+    return escapeKernelScalar;
+}
+
+const char *escapeKernelName(EscapeKernel kernel) {
+#ifdef ESCAPE_KERNEL_X86
+    if (kernel == escapeKernelAVX512) return "AVX-512";
+    if (kernel == escapeKernelAVX2) return "AVX2";
+#endif
+    return "scalar";
+}
@@ -0,0 +1,44 @@
+#ifndef ESCAPEKERNEL_H
+#define ESCAPEKERNEL_H
+
+#include "doubleDouble.h"
+
+//The escape-time kernels take a batch of points of the complex plane and write
+//the escape-time of each one to iters. Every kernel does exactly the same
+//floating point operations in the same order, so they all give identical results;
+//the wide ones just iterate 4 (AVX2) or 8 (AVX-512) points at a time.
+//
+//Each point starts from the orbit value (zx, zy) at iteration iters, which is
+//z = 0 at iteration 0 for a fresh point. This lets a point that hit an earlier
+//max_iter carry on from where it stopped. When a point reaches max_iter its
+//final z is written back to zx and zy so it can be continued again later.
+//
+//With check_interior, points inside the main cardioid or the period-2 bulb and
+//orbits that land exactly on a cycle stop early with max_iter. That can't change
+//any result, but their z is written back as NaN since they never got there.
+typedef void (*EscapeKernel)(const double *cx, const double *cy, double *zx, double *zy,
+                             unsigned int *iters, int count, unsigned int max_iter,
+                             bool check_interior);
+
+//plain one-point-at-a-time version, works everywhere
+void escapeKernelScalar(const double *cx, const double *cy, double *zx, double *zy,
+                        unsigned int *iters, int count, unsigned int max_iter,
+                        bool check_interior);
+
+//the same loop in double-double, for views too deep for doubles but not yet
+//deep enough to need perturbation. These kernels always start at z = 0 and
+//don't save orbits
+typedef void (*DoubleDoubleKernel)(const DoubleDouble *cx, const DoubleDouble *cy,
+                                   unsigned int *iters, int count, unsigned int max_iter);
+
+void escapeKernelDoubleDouble(const DoubleDouble *cx, const DoubleDouble *cy,
+                              unsigned int *iters, int count, unsigned int max_iter);
+
+//returns the widest kernel the current CPU supports (checked with CPUID)
+EscapeKernel selectEscapeKernel();
+DoubleDoubleKernel selectDoubleDoubleKernel();
+
+//returns a printable name for a kernel ("AVX-512", "AVX2" or "scalar")
+const char *escapeKernelName(EscapeKernel kernel);
+
+#endif
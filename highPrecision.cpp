@@ -0,0 +1,267 @@
+#include "highPrecision.h"
+#include <math.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdexcept>
+
+HighPrecision::HighPrecision(int words) {
+    negative = false;
+    limbs.assign(words + 1, 0);
+}
+
+//converts a double exactly (as far as the precision allows)
+HighPrecision::HighPrecision(double value, int words) {
+    negative = value < 0;
+    limbs.assign(words + 1, 0);
+    value = fabs(value);
+
+    double whole = floor(value);
+    limbs[0] = (uint32_t) whole;
+    value -= whole;
+
+    //shift the fraction up 32 bits at a time, this is exact for doubles
+    for (unsigned int i=1; i<limbs.size() && value != 0; i++) {
+        value *= 4294967296.0;
+        whole = floor(value);
+        limbs[i] = (uint32_t) whole;
+        value -= whole;
+    }
+}
+
+//changes the number of fraction words, dropping or padding the least significant ones
+void HighPrecision::setPrecision(int words) {
+    limbs.resize(words + 1, 0);
+}
+
+double HighPrecision::toDouble() const {
+    //start at the first non-zero word, so tiny numbers keep their precision.
+    //Three words hold more than the 53 bits a double can take
+    unsigned int first = 0;
+    while (first < limbs.size() && limbs[first] == 0) first++;
+
+    double value = 0;
+    for (unsigned int i=first; i<limbs.size() && i<first+3; i++) {
+        value += ldexp((double) limbs[i], -32 * (int) i);
+    }
+    return negative ? -value : value;
+}
+
+//the double nearest to the number, plus the double nearest to what's left over
+DoubleDouble HighPrecision::toDoubleDouble() const {
+    double hi = toDouble();
+    double lo = (*this - HighPrecision(hi, getPrecision())).toDouble();
+    return DoubleDouble(hi, lo);
+}
+
+//prints the number in decimal with the given number of digits after the point
+std::string HighPrecision::toString(int digits) const {
+    std::string str = negative ? "-" : "";
+    str += std::to_string(limbs[0]);
+    str += ".";
+
+    //multiply the fraction by 10 over and over, the carry out is the next digit
+    std::vector<uint32_t> fraction(limbs.begin() + 1, limbs.end());
+    for (int d=0; d<digits; d++) {
+        uint64_t carry = 0;
+        for (int i=fraction.size()-1; i>=0; i--) {
+            uint64_t product = (uint64_t) fraction[i] * 10 + carry;
+            fraction[i] = (uint32_t) product;
+            carry = product >> 32;
+        }
+        str += (char) ('0' + carry);
+    }
+    return str;
+}
+
+bool HighPrecision::parse(const std::string &text, int words, HighPrecision &result) {
+    unsigned int pos = 0;
+    bool negative = false;
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) negative = text[pos++] == '-';
+
+    //collect the digits, and where the point goes among them
+    std::string digits;
+    int point = -1;
+    for (; pos < text.size(); pos++) {
+        char c = text[pos];
+        if (c >= '0' && c <= '9') digits += c;
+        else if (c == '.' && point < 0) point = digits.size();
+        else break;
+    }
+    if (digits.empty()) return false;
+    if (point < 0) point = digits.size();
+
+    //an exponent just moves the point
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        pos++;
+        size_t used = 0;
+        int exponent;
+        try {
+            exponent = std::stoi(text.substr(pos), &used);
+        } catch (...) {
+            return false;
+        }
+        if (used == 0) return false;
+        pos += used;
+        point += exponent;
+    }
+    if (pos != text.size()) return false;
+
+    //pad with zeros so the point falls inside the digits
+    if (point < 0) {
+        digits.insert(0, -point, '0');
+        point = 0;
+    } else if (point > (int) digits.size()) {
+        digits.append(point - digits.size(), '0');
+    }
+
+    uint64_t whole = 0;
+    for (int i=0; i<point; i++) {
+        whole = whole * 10 + (digits[i] - '0');
+        if (whole > 0xFFFFFFFFull) return false;
+    }
+
+    //work out the fraction from the last digit back: each step adds a digit in
+    //front of the point and divides by 10. One extra word soaks up the rounding
+    std::vector<uint32_t> fraction(words + 1, 0);
+    for (int i=digits.size()-1; i>=point; i--) {
+        uint64_t remainder = digits[i] - '0';
+        for (unsigned int k=0; k<fraction.size(); k++) {
+            uint64_t current = remainder << 32 | fraction[k];
+            fraction[k] = (uint32_t) (current / 10);
+            remainder = current % 10;
+        }
+    }
+
+    result = HighPrecision(words);
+    result.limbs[0] = (uint32_t) whole;
+    bool zero = whole == 0;
+    for (int k=0; k<words; k++) {
+        result.limbs[k + 1] = fraction[k];
+        if (fraction[k] != 0) zero = false;
+    }
+    result.negative = negative && !zero;
+    return true;
+}
+
+std::string HighPrecision::toHex() const {
+    unsigned int used = limbs.size();
+    while (used > 1 && limbs[used-1] == 0) used--;
+
+    bool zero = used == 1 && limbs[0] == 0;
+    std::string str = negative && !zero ? "-" : "";
+    char word[16];
+    for (unsigned int i=0; i<used; i++) {
+        snprintf(word, sizeof(word), i == 0 ? "%x" : ".%08x", limbs[i]);
+        str += word;
+    }
+    return str;
+}
+
+HighPrecision HighPrecision::truncated(int exponent) const {
+    HighPrecision result = *this;
+    for (unsigned int i=0; i<result.limbs.size(); i++) {
+        //bit b of word i is worth 2^(b - 32i)
+        int lowest_kept = exponent + 32 * (int) i;
+        if (lowest_kept <= 0) continue;
+        if (lowest_kept >= 32) result.limbs[i] = 0;
+        else result.limbs[i] &= ~((1u << lowest_kept) - 1);
+    }
+    return result;
+}
+
+HighPrecision HighPrecision::operator-() const {
+    HighPrecision result = *this;
+    result.negative = !negative;
+    return result;
+}
+
+HighPrecision HighPrecision::operator+(const HighPrecision &other) const {
+    if (negative == other.negative)
+        return addMagnitude(*this, other, negative);
+    //the signs differ, so subtract the smaller magnitude from the larger one
+    if (compareMagnitude(*this, other) >= 0)
+        return subMagnitude(*this, other, negative);
+    return subMagnitude(other, *this, other.negative);
+}
+
+HighPrecision HighPrecision::operator-(const HighPrecision &other) const {
+    return *this + (-other);
+}
+
+//multiplies word by word (schoolbook), then truncates back to the larger precision
+HighPrecision HighPrecision::operator*(const HighPrecision &other) const {
+    int n = std::max(limbs.size(), other.limbs.size());
+    int na = limbs.size(), nb = other.limbs.size();
+
+    //acc[k] collects everything with a weight of 2^(-32k). Every product is split
+    //in half so that the sums can't overflow 64 bits
+    std::vector<uint64_t> acc(na + nb, 0);
+    for (int i=0; i<na; i++) {
+        if (limbs[i] == 0) continue;
+        for (int j=0; j<nb; j++) {
+            uint64_t product = (uint64_t) limbs[i] * other.limbs[j];
+            acc[i+j] += (uint32_t) product;
+            if (i+j > 0) acc[i+j-1] += product >> 32;
+        }
+    }
+
+    //propagate the carries from the least significant word up
+    for (int k=acc.size()-1; k>0; k--) {
+        acc[k-1] += acc[k] >> 32;
+        acc[k] &= 0xFFFFFFFF;
+    }
+
+    HighPrecision result(n - 1);
+    result.negative = negative != other.negative;
+    for (int k=0; k<n; k++) {
+        result.limbs[k] = (uint32_t) acc[k];
+    }
+    return result;
+}
+
+int HighPrecision::wordsFor(double inc) {
+    //64 spare bits, on top of the bits needed to get down to inc
+    int bits = (int) ceil(-log2(inc)) + 64;
+    return std::max(2, bits / 32 + 1);
+}
+
+int HighPrecision::compareMagnitude(const HighPrecision &a, const HighPrecision &b) {
+    unsigned int n = std::max(a.limbs.size(), b.limbs.size());
+    for (unsigned int i=0; i<n; i++) {
+        uint32_t x = i < a.limbs.size() ? a.limbs[i] : 0;
+        uint32_t y = i < b.limbs.size() ? b.limbs[i] : 0;
+        if (x != y) return x < y ? -1 : 1;
+    }
+    return 0;
+}
+
+HighPrecision HighPrecision::addMagnitude(const HighPrecision &a, const HighPrecision &b, bool negative) {
+    int n = std::max(a.limbs.size(), b.limbs.size());
+    HighPrecision result(n - 1);
+    result.negative = negative;
+    uint64_t carry = 0;
+    for (int i=n-1; i>=0; i--) {
+        uint64_t sum = carry;
+        if (i < (int) a.limbs.size()) sum += a.limbs[i];
+        if (i < (int) b.limbs.size()) sum += b.limbs[i];
+        result.limbs[i] = (uint32_t) sum;
+        carry = sum >> 32;
+    }
+    return result;
+}
+
+//a must have the larger magnitude
+HighPrecision HighPrecision::subMagnitude(const HighPrecision &a, const HighPrecision &b, bool negative) {
+    int n = std::max(a.limbs.size(), b.limbs.size());
+    HighPrecision result(n - 1);
+    result.negative = negative;
+    int64_t borrow = 0;
+    for (int i=n-1; i>=0; i--) {
+        int64_t diff = -borrow;
+        if (i < (int) a.limbs.size()) diff += a.limbs[i];
+        if (i < (int) b.limbs.size()) diff -= b.limbs[i];
+        borrow = diff < 0 ? 1 : 0;
+        result.limbs[i] = (uint32_t) (diff + (borrow << 32));
+    }
+    return result;
+}
@@ -0,0 +1,59 @@
+#ifndef HIGHPRECISION_H
+#define HIGHPRECISION_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "doubleDouble.h"
+
+//HighPrecision is a signed fixed point number with a 32 bit integer part and as
+//many 32 bit words of fraction as it is given. Everything the deep zoom does with
+//it stays well below 2^32 in magnitude, so a fixed point is all it needs.
+//Operations between numbers of different precision give the larger precision.
+class HighPrecision {
+    public:
+        HighPrecision(int words = 2);
+        HighPrecision(double value, int words);
+
+        int getPrecision() const {return limbs.size() - 1;}
+        void setPrecision(int words);
+
+        double toDouble() const;
+        DoubleDouble toDoubleDouble() const;
+        std::string toString(int digits) const;
+        //the exact value in hex words, with no trailing zero words. Numbers that
+        //are equal give the same string whatever their precision
+        std::string toHex() const;
+
+        //the number with every bit worth less than 2^exponent cleared (so it's
+        //rounded towards zero to a multiple of 2^exponent)
+        HighPrecision truncated(int exponent) const;
+
+        HighPrecision operator-() const;
+        HighPrecision operator+(const HighPrecision &other) const;
+        HighPrecision operator-(const HighPrecision &other) const;
+        HighPrecision operator*(const HighPrecision &other) const;
+        HighPrecision &operator+=(const HighPrecision &other) {return *this = *this + other;}
+        HighPrecision &operator-=(const HighPrecision &other) {return *this = *this - other;}
+
+        //reads a decimal number like "-0.743643887037158704752191506114774" or
+        //"1.5e-3" with the given number of fraction words. Returns false if the
+        //text isn't a number or doesn't fit in the 32 bit integer part
+        static bool parse(const std::string &text, int words, HighPrecision &result);
+
+        //returns how many words of fraction are needed to tell apart points that
+        //are inc apart, with plenty of room left over for rounding
+        static int wordsFor(double inc);
+
+    private:
+        bool negative;
+
+        //limbs[0] is the integer part, the rest is the fraction, most significant first
+        std::vector<uint32_t> limbs;
+
+        static int compareMagnitude(const HighPrecision &a, const HighPrecision &b);
+        static HighPrecision addMagnitude(const HighPrecision &a, const HighPrecision &b, bool negative);
+        static HighPrecision subMagnitude(const HighPrecision &a, const HighPrecision &b, bool negative);
+};
+
+#endif
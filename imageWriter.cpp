@@ -0,0 +1,198 @@
+#include "imageWriter.h"
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//IDAT chunks are written out whenever this much compressed data has built up
+static const size_t chunk_size = 1 << 16;
+
+static void putBigEndian(unsigned char *out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static bool endsWith(const std::string &str, const std::string &end) {
+    if (str.size() < end.size()) return false;
+    for (unsigned int i=0; i<end.size(); i++) {
+        if (tolower(str[str.size() - end.size() + i]) != end[i]) return false;
+    }
+    return true;
+}
+
+ImageWriter::ImageWriter() {
+    file = NULL;
+    format = FORMAT_PPM;
+    failed = false;
+    mapped = NULL;
+    mapped_size = 0;
+    width = 0;
+    height = 0;
+    rows_written = 0;
+}
+
+ImageWriter::~ImageWriter() {
+    if (file != NULL) close();
+}
+
+bool ImageWriter::open(const std::string &filename, int width, int height) {
+    if (file != NULL) close();
+    if (endsWith(filename, ".png")) format = FORMAT_PNG;
+    else if (endsWith(filename, ".raw")) format = FORMAT_RAW;
+    else format = FORMAT_PPM;
+
+    //a shared, writable map needs the file open for reading too
+    file = fopen(filename.c_str(), format == FORMAT_RAW ? "w+b" : "wb");
+    if (file == NULL) return false;
+
+    this->width = width;
+    this->height = height;
+    rows_written = 0;
+    failed = false;
+
+    if (format == FORMAT_PPM) {
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        row.resize((size_t) width * 3);
+        return !ferror(file);
+    }
+
+    if (format == FORMAT_RAW) {
+        //size the file up front and map all of it. The rows are copied straight
+        //in, and the kernel writes them out in the background
+        mapped_size = (size_t) width * height * 4;
+        int fd = fileno(file);
+        if (mapped_size == 0 || ftruncate(fd, mapped_size) != 0) {
+            failed = true;
+            return false;
+        }
+        void *address = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            failed = true;
+            return false;
+        }
+        mapped = (unsigned char *) address;
+        return true;
+    }
+
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    fwrite(signature, 1, sizeof(signature), file);
+
+    //8 bit RGB, no interlacing
+    unsigned char header[13];
+    putBigEndian(header, width);
+    putBigEndian(header + 4, height);
+    header[8] = 8;
+    header[9] = 2;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+    writeChunk("IHDR", header, sizeof(header));
+
+    //every PNG row starts with its filter type, 0 is none
+    row.resize((size_t) width * 3 + 1);
+    compressed.resize(chunk_size);
+    memset(&deflater, 0, sizeof(deflater));
+    if (deflateInit(&deflater, Z_DEFAULT_COMPRESSION) != Z_OK) failed = true;
+    deflater.next_out = compressed.data();
+    deflater.avail_out = compressed.size();
+    return !failed;
+}
+
+bool ImageWriter::writeRows(const unsigned char *rgba, int rows) {
+    if (file == NULL || failed) return false;
+    rows = std::min(rows, height - rows_written);
+    if (format == FORMAT_RAW) {
+        size_t start = (size_t) rows_written * width * 4;
+        size_t length = (size_t) rows * width * 4;
+        memcpy(mapped + start, rgba, length);
+        rows_written += rows;
+
+        //start writing the rows out, and unmap them from this process so a huge
+        //file doesn't pile up in memory. The data stays in the file
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t first = start / page * page;
+        msync(mapped + first, start + length - first, MS_ASYNC);
+        madvise(mapped + first, start + length - first, MADV_DONTNEED);
+        return true;
+    }
+    bool png = format == FORMAT_PNG;
+    for (int i=0; i<rows; i++) {
+        const unsigned char *in = rgba + (size_t) i * width * 4;
+        unsigned char *out = png ? &row[1] : &row[0];
+        if (png) row[0] = 0;
+        for (int j=0; j<width; j++) {
+            out[j*3] = in[j*4];
+            out[j*3 + 1] = in[j*4 + 1];
+            out[j*3 + 2] = in[j*4 + 2];
+        }
+        if (png) deflateRow(Z_NO_FLUSH);
+        else if (fwrite(row.data(), 1, row.size(), file) != row.size()) failed = true;
+        rows_written++;
+    }
+    return !failed;
+}
+
+bool ImageWriter::close() {
+    if (file == NULL) return false;
+    if (mapped != NULL) {
+        if (msync(mapped, mapped_size, MS_SYNC) != 0) failed = true;
+        munmap(mapped, mapped_size);
+        mapped = NULL;
+    }
+    if (format == FORMAT_PNG) {
+        deflater.avail_in = 0;
+        deflateRow(Z_FINISH);
+        deflateEnd(&deflater);
+        writeChunk("IEND", NULL, 0);
+    }
+    if (fclose(file) != 0) failed = true;
+    file = NULL;
+    return !failed && rows_written == height;
+}
+
+//deflates the row in the buffer, writing IDAT chunks as the output fills up.
+//With Z_FINISH it flushes everything that's left instead
+void ImageWriter::deflateRow(int flush) {
+    if (flush != Z_FINISH) {
+        deflater.next_in = row.data();
+        deflater.avail_in = row.size();
+    }
+    while (true) {
+        int status = deflate(&deflater, flush);
+        if (status == Z_STREAM_ERROR) {
+            failed = true;
+            return;
+        }
+        bool full = deflater.avail_out == 0;
+        if (full || (flush == Z_FINISH && status == Z_STREAM_END)) {
+            writeChunk("IDAT", compressed.data(), compressed.size() - deflater.avail_out);
+            deflater.next_out = compressed.data();
+            deflater.avail_out = compressed.size();
+        }
+        if (flush == Z_FINISH ? status == Z_STREAM_END : (deflater.avail_in == 0 && !full)) return;
+    }
+}
+
+//a chunk is its length, its type, the data, then a CRC of the type and data
+void ImageWriter::writeChunk(const char *type, const unsigned char *data, size_t length) {
+    unsigned char word[4];
+    putBigEndian(word, length);
+    fwrite(word, 1, 4, file);
+    fwrite(type, 1, 4, file);
+    if (length > 0) fwrite(data, 1, length, file);
+
+    uLong crc = crc32(0, (const Bytef *) type, 4);
+    if (length > 0) crc = crc32(crc, data, length);
+    putBigEndian(word, crc);
+    if (fwrite(word, 1, 4, file) != 4) failed = true;
+}
+
+bool writeImage(const std::string &filename, const unsigned char *rgba, int width, int height) {
+    ImageWriter writer;
+    if (!writer.open(filename, width, height)) return false;
+    writer.writeRows(rgba, height);
+    return writer.close();
+}
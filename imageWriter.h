@@ -0,0 +1,50 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <zlib.h>
+
+//ImageWriter writes an image to a file a few rows at a time, so the whole image
+//never has to be in memory. Files ending in .png are written as PNG, .raw as
+//bare RGBA rows (through a memory map, which is the fastest for huge images),
+//and anything else as a binary PPM. The rows given to it are RGBA, the alpha is
+//dropped except in raw files.
+class ImageWriter {
+    public:
+        ImageWriter();
+        ~ImageWriter();
+
+        bool open(const std::string &filename, int width, int height);
+        //adds the next rows of the image, each width RGBA pixels long
+        bool writeRows(const unsigned char *rgba, int rows);
+        //finishes the file. Returns false if anything failed along the way, or
+        //if fewer rows were written than the image has
+        bool close();
+
+    private:
+        enum Format { FORMAT_PPM, FORMAT_PNG, FORMAT_RAW };
+
+        FILE *file;
+        Format format;
+        bool failed;
+        int width;
+        int height;
+        int rows_written;
+
+        z_stream deflater;
+        std::vector<unsigned char> row;        //one row as it goes into the file
+        std::vector<unsigned char> compressed; //deflated data waiting to go into an IDAT chunk
+
+        unsigned char *mapped; //the whole raw file
+        size_t mapped_size;
+
+        void writeChunk(const char *type, const unsigned char *data, size_t length);
+        void deflateRow(int flush);
+};
+
+//writes a whole RGBA image in one go
+bool writeImage(const std::string &filename, const unsigned char *rgba, int width, int height);
+
+#endif
@@ -0,0 +1,129 @@
+#include "iterationBuffer.h"
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+IterationBuffer::IterationBuffer() {
+    width = 0;
+    height = 0;
+    row_bytes = 0;
+    compact = false;
+    data = NULL;
+}
+
+//rows are padded up to a whole number of cache lines
+size_t IterationBuffer::rowBytes(int width, bool compact) {
+    size_t bytes = (size_t) width * (compact ? 2 : 4);
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+void IterationBuffer::resize(int new_width, int new_height) {
+    width = new_width;
+    height = new_height;
+    row_bytes = rowBytes(width, compact);
+
+    //always leave room for the 32 bit layout, so setCompact never reallocates
+    size_t needed = rowBytes(width, false) * height + alignment;
+    if (storage.size() < needed) {
+        storage.clear();
+        storage.resize(needed);
+    }
+    uintptr_t address = (uintptr_t) storage.data();
+    data = storage.data() + (alignment - address % alignment) % alignment;
+    memset(data, 0, row_bytes * height);
+}
+
+void IterationBuffer::setCompact(bool new_compact) {
+    if (new_compact == compact) return;
+    size_t new_row_bytes = rowBytes(width, new_compact);
+
+    //convert in place. Going compact everything moves down, so it's done front
+    //to back. Going wide everything moves up, so back to front
+    if (new_compact) {
+        for (int i=0; i<height; i++) {
+            const uint32_t *src = rowPointer<uint32_t>(i);
+            uint16_t *dst = (uint16_t *) (data + (size_t) i * new_row_bytes);
+            for (int j=0; j<width; j++) {
+                uint32_t value = src[j];
+                dst[j] = std::min(value, (uint32_t) 65535);
+            }
+        }
+    } else {
+        for (int i=height-1; i>=0; i--) {
+            const uint16_t *src = rowPointer<uint16_t>(i);
+            uint32_t *dst = (uint32_t *) (data + (size_t) i * new_row_bytes);
+            for (int j=width-1; j>=0; j--) {
+                uint16_t value = src[j];
+                dst[j] = value;
+            }
+        }
+    }
+    compact = new_compact;
+    row_bytes = new_row_bytes;
+}
+
+void IterationBuffer::shift(int dx, int dy) {
+    if (abs(dx) >= width || abs(dy) >= height) {
+        memset(data, 0, row_bytes * height);
+        return;
+    }
+    size_t element = compact ? 2 : 4;
+    size_t kept = (width - abs(dx)) * element;
+    size_t from = dx > 0 ? dx * element : 0;
+    size_t to = dx < 0 ? -dx * element : 0;
+
+    //go through the rows in the order that never overwrites one before it's moved
+    for (int n=0; n<height; n++) {
+        int i = dy > 0 ? n : height - 1 - n;
+        char *row = data + (size_t) i * row_bytes;
+        int source = i + dy;
+        if (source < 0 || source >= height) {
+            memset(row, 0, width * element);
+            continue;
+        }
+        memmove(row + to, data + (size_t) source * row_bytes + from, kept);
+        //clear the columns that came in from the side
+        if (dx > 0) memset(row + kept, 0, dx * element);
+        else if (dx < 0) memset(row, 0, -dx * element);
+    }
+}
+
+template <typename T>
+void IterationBuffer::fillRectAs(int min_x, int min_y, int max_x, int max_y, unsigned int value) {
+    for (int i=min_y; i<=max_y; i++) {
+        T *row = rowPointer<T>(i);
+        std::fill(row + min_x, row + max_x + 1, (T) value);
+    }
+}
+
+template <typename T>
+bool IterationBuffer::rowEqualsAs(int row, int min_x, int max_x, unsigned int value) const {
+    const T *r = rowPointer<T>(row);
+    for (int j=min_x; j<=max_x; j++) {
+        if (r[j] != value) return false;
+    }
+    return true;
+}
+
+template <typename T>
+bool IterationBuffer::columnEqualsAs(int column, int min_y, int max_y, unsigned int value) const {
+    for (int i=min_y; i<=max_y; i++) {
+        if (rowPointer<T>(i)[column] != value) return false;
+    }
+    return true;
+}
+
+void IterationBuffer::fillRect(int min_x, int min_y, int max_x, int max_y, unsigned int value) {
+    if (compact) fillRectAs<uint16_t>(min_x, min_y, max_x, max_y, value);
+    else fillRectAs<uint32_t>(min_x, min_y, max_x, max_y, value);
+}
+
+bool IterationBuffer::rowEquals(int row, int min_x, int max_x, unsigned int value) const {
+    if (compact) return rowEqualsAs<uint16_t>(row, min_x, max_x, value);
+    return rowEqualsAs<uint32_t>(row, min_x, max_x, value);
+}
+
+bool IterationBuffer::columnEquals(int column, int min_y, int max_y, unsigned int value) const {
+    if (compact) return columnEqualsAs<uint16_t>(column, min_y, max_y, value);
+    return columnEqualsAs<uint32_t>(column, min_y, max_y, value);
+}
@@ -0,0 +1,76 @@
+#ifndef ITERATIONBUFFER_H
+#define ITERATIONBUFFER_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//IterationBuffer holds the escape-time of every pixel in one contiguous block,
+//row after row. Every row starts on a cache line, so rows are stride elements
+//apart rather than width. The elements are 32 bit, or 16 bit when the buffer is
+//compact, which halves the memory the generators and the coloring walk through.
+//A compact buffer can only hold counts up to 65535, so it should only be used
+//while max_iter is below that.
+class IterationBuffer {
+    public:
+        IterationBuffer();
+
+        //sets the size and clears every count to 0. The memory is only
+        //reallocated when the buffer grows
+        void resize(int width, int height);
+        //switches the element type, keeping the counts (clamped to 65535 when
+        //going compact)
+        void setCompact(bool compact);
+
+        int getWidth() const {return width;}
+        int getHeight() const {return height;}
+        int getStride() const {return row_bytes / (compact ? 2 : 4);}
+        bool isCompact() const {return compact;}
+
+        unsigned int get(int row, int column) const {
+            if (compact) return rowPointer<uint16_t>(row)[column];
+            return rowPointer<uint32_t>(row)[column];
+        }
+        void set(int row, int column, unsigned int value) {
+            if (compact) rowPointer<uint16_t>(row)[column] = value;
+            else rowPointer<uint32_t>(row)[column] = value;
+        }
+
+        //moves the contents so that (row, column) gets what was at
+        //(row + dy, column + dx). What moves in from outside is set to 0
+        void shift(int dx, int dy);
+
+        //sets every count inside the rectangle (edges included) to value
+        void fillRect(int min_x, int min_y, int max_x, int max_y, unsigned int value);
+        //checks if every count on part of a row or column is equal to value
+        bool rowEquals(int row, int min_x, int max_x, unsigned int value) const;
+        bool columnEquals(int column, int min_y, int max_y, unsigned int value) const;
+
+        template <typename T>
+        T *rowPointer(int row) {return (T *) (data + (size_t) row * row_bytes);}
+        template <typename T>
+        const T *rowPointer(int row) const {return (const T *) (data + (size_t) row * row_bytes);}
+
+    private:
+        static const int alignment = 64;
+
+        int width;
+        int height;
+        size_t row_bytes;
+        bool compact;
+
+        //data is the first aligned byte of storage
+        std::vector<char> storage;
+        char *data;
+
+        static size_t rowBytes(int width, bool compact);
+
+        template <typename T>
+        void fillRectAs(int min_x, int min_y, int max_x, int max_y, unsigned int value);
+        template <typename T>
+        bool rowEqualsAs(int row, int min_x, int max_x, unsigned int value) const;
+        template <typename T>
+        bool columnEqualsAs(int column, int min_y, int max_y, unsigned int value) const;
+};
+
+#endif
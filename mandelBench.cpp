@@ -0,0 +1,224 @@
+#include "mandelbrotRenderer.h"
+#include "escapeKernel.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+//the views every run renders, picked to stress different parts of the renderer
+struct BenchView {
+    const char *name;
+    const char *x;
+    const char *y;
+    double width;
+};
+static const BenchView views[] = {
+    //the whole set: a lot of fast escapes, and big flat areas for the quadtree
+    {"full", "-0.5", "0", 3.5},
+    //detail everywhere, so little for the quadtree to fill in
+    {"seahorse", "-0.7453", "0.1127", 0.02},
+    //almost all in the main cardioid, every pixel goes to max_iter unless the
+    //interior checks catch it
+    {"interior", "-0.15", "0", 0.5},
+    //thin filaments around c = i, slow escapes next to fast ones
+    {"filament", "-0.1011", "0.9563", 0.02},
+    //a 1e-12 wide view, past double precision
+    {"deep", "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 1e-12},
+};
+static const int view_count = sizeof(views) / sizeof(views[0]);
+
+struct BenchResult {
+    const char *view;
+    const char *generator;
+    int iterations;
+    unsigned int threads;
+    double seconds;
+    double mpixels;
+    double iterations_per_second;
+    double efficiency; //NaN without a 1 thread run to compare to
+};
+
+static void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  --size WIDTHxHEIGHT  resolution of every render (960x540)\n"
+              << "  --iterations A,B,..  iteration caps to run each view at (250,1000,4000)\n"
+              << "  --threads A,B,..     thread counts to run each view with (1, 2, 4... all cores)\n"
+              << "  --generators A,B     generators to run each case with (quadtree,scanline)\n"
+              << "  --repeat N           renders of each case, the fastest one counts (3)\n"
+              << "  --json FILE          also write the results to FILE as JSON\n";
+}
+
+//reads a comma separated list of positive numbers
+static bool readList(const char *text, std::vector<int> &list) {
+    list.clear();
+    while (*text) {
+        char *end;
+        long value = strtol(text, &end, 10);
+        if (end == text || value < 1 || (*end != ',' && *end != '\0')) return false;
+        list.push_back((int) value);
+        text = *end == ',' ? end + 1 : end;
+    }
+    return !list.empty();
+}
+
+//reads a comma separated list of generator names
+static bool readGenerators(const std::string &text, std::vector<MandelbrotRenderer::Generator> &list) {
+    list.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        std::string name = text.substr(start, end - start);
+        if (name == "quadtree") list.push_back(MandelbrotRenderer::GENERATOR_QUADTREE);
+        else if (name == "scanline") list.push_back(MandelbrotRenderer::GENERATOR_SCANLINE);
+        else return false;
+        start = end + 1;
+    }
+    return !list.empty();
+}
+
+static const char *generatorName(MandelbrotRenderer::Generator generator) {
+    return generator == MandelbrotRenderer::GENERATOR_SCANLINE ? "scanline" : "quadtree";
+}
+
+static bool writeJson(const std::string &filename, const std::vector<BenchResult> &results,
+                      int res_width, int res_height, int repeat, double score) {
+    FILE *file = fopen(filename.c_str(), "w");
+    if (file == NULL) return false;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"kernel\": \"%s\",\n", escapeKernelName(selectEscapeKernel()));
+#ifdef __VERSION__
+    fprintf(file, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    fprintf(file, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n  \"repeat\": %d,\n", res_width, res_height, repeat);
+    fprintf(file, "  \"score\": %.4f,\n", score);
+    fprintf(file, "  \"results\": [\n");
+    for (unsigned int i=0; i<results.size(); i++) {
+        const BenchResult &r = results[i];
+        fprintf(file, "    {\"view\": \"%s\", \"generator\": \"%s\", \"iterations\": %d, \"threads\": %u, "
+                      "\"seconds\": %.6f, \"mpixels_per_s\": %.4f, \"iterations_per_s\": %.6g, \"efficiency\": ",
+                r.view, r.generator, r.iterations, r.threads, r.seconds, r.mpixels, r.iterations_per_second);
+        if (isnan(r.efficiency)) fprintf(file, "null");
+        else fprintf(file, "%.4f", r.efficiency);
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+//renders a fixed set of views at a few iteration caps and thread counts, and
+//reports how fast each one went, to compare builds and machines
+int main(int argc, char **argv) {
+    int res_width = 960, res_height = 540, repeat = 3;
+    std::vector<int> iteration_caps, thread_counts;
+    iteration_caps.push_back(250);
+    iteration_caps.push_back(1000);
+    iteration_caps.push_back(4000);
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int n=1; n<cores; n*=2) thread_counts.push_back(n);
+    thread_counts.push_back(cores);
+    std::vector<MandelbrotRenderer::Generator> generators;
+    generators.push_back(MandelbrotRenderer::GENERATOR_QUADTREE);
+    generators.push_back(MandelbrotRenderer::GENERATOR_SCANLINE);
+    std::string json;
+
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--size" && has_value &&
+            sscanf(argv[i+1], "%dx%d", &res_width, &res_height) == 2 &&
+            res_width > 2 && res_height > 2 &&
+            res_width <= MandelbrotRenderer::max_resolution &&
+            res_height <= MandelbrotRenderer::max_resolution) {
+            i++;
+        } else if (arg == "--iterations" && has_value && readList(argv[i+1], iteration_caps)) {
+            i++;
+        } else if (arg == "--threads" && has_value && readList(argv[i+1], thread_counts)) {
+            i++;
+        } else if (arg == "--generators" && has_value && readGenerators(argv[i+1], generators)) {
+            i++;
+        } else if (arg == "--repeat" && has_value && (repeat = atoi(argv[i+1])) >= 1) {
+            i++;
+        } else if (arg == "--json" && has_value) {
+            json = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    MandelbrotRenderer renderer(res_width, res_height);
+    renderer.enableTileCache(false);
+    renderer.setVerbose(false);
+    double pixels = (double) res_width * res_height;
+
+    printf("%-10s %-9s %10s %7s %10s %10s %12s %10s\n", "view", "generator",
+           "iterations", "threads", "seconds", "Mpixels/s", "iterations/s", "efficiency");
+    std::vector<BenchResult> results;
+    double log_sum = 0;
+    for (int v=0; v<view_count; v++) {
+        int words = HighPrecision::wordsFor(views[v].width / res_width);
+        HighPrecision x, y;
+        HighPrecision::parse(views[v].x, words, x);
+        HighPrecision::parse(views[v].y, words, y);
+
+        for (unsigned int g=0; g<generators.size(); g++) {
+            renderer.setGenerator(generators[g]);
+            for (unsigned int c=0; c<iteration_caps.size(); c++) {
+                double single_thread = NAN;
+                for (unsigned int t=0; t<thread_counts.size(); t++) {
+                    renderer.setThreads(thread_counts[t]);
+                    renderer.setIterations(iteration_caps[c]);
+
+                    //setView throws away everything the last render could reuse
+                    double best = INFINITY;
+                    for (int r=0; r<repeat; r++) {
+                        renderer.setView(x, y, views[v].width);
+                        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                        renderer.generate();
+                        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                        best = std::min(best, seconds);
+                    }
+
+                    BenchResult result;
+                    result.view = views[v].name;
+                    result.generator = generatorName(generators[g]);
+                    result.iterations = iteration_caps[c];
+                    result.threads = thread_counts[t];
+                    result.seconds = best;
+                    result.mpixels = pixels / best / 1e6;
+                    result.iterations_per_second = renderer.countIterations() / best;
+                    if (thread_counts[t] == 1) single_thread = best;
+                    result.efficiency = single_thread / (best * thread_counts[t]);
+                    results.push_back(result);
+                    log_sum += log(result.mpixels);
+
+                    printf("%-10s %-9s %10d %7u %10.4f %10.2f %12.4g ", result.view, result.generator,
+                           result.iterations, result.threads, result.seconds, result.mpixels,
+                           result.iterations_per_second);
+                    if (isnan(result.efficiency)) printf("%10s\n", "-");
+                    else printf("%9.0f%%\n", 100 * result.efficiency);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    //one number to compare runs by: the geometric mean of every case's Mpixels/s
+    double score = exp(log_sum / results.size());
+    printf("score %.2f Mpixels/s\n", score);
+
+    if (!json.empty()) {
+        if (!writeJson(json, results, res_width, res_height, repeat, score)) {
+            std::cerr << "ERROR: unable to write " << json << "\n";
+            return 1;
+        }
+        printf("Saved results to %s\n", json.c_str());
+    }
+    return 0;
+}
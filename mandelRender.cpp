@@ -0,0 +1,229 @@
+#include "mandelbrotRenderer.h"
+#include "tiledRenderer.h"
+#include "zoomMovie.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+
+# define PI 3.14159265358979323846
+
+//images bigger than this are rendered in tiles, so they don't have to fit in memory
+static const double max_untiled_pixels = 64e6;
+static const int max_untiled_side = 16384;
+
+//renders one image of the mandelbrot to a file, with no window. Everything but
+//the output file has a default, which is the explorer's starting view
+static void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [options] output.png|output.ppm|output.raw\n"
+              << "       " << name << " --frames N [options] frame%05d.png|-\n"
+              << "  --center X Y         center of the view, as decimals of any precision (-0.5 0)\n"
+              << "  --width W            width of the view on the complex plane (2 * WIDTH/HEIGHT)\n"
+              << "  --size WIDTHxHEIGHT  resolution of the image (1920x1080)\n"
+              << "  --iterations N       maximum iterations (1000)\n"
+              << "  --scheme N           color scheme, 1-5 (1)\n"
+              << "  --color-multiple M   color multiplier (1)\n"
+              << "  --rotation DEGREES   rotation of the view (0)\n"
+              << "  --threads N          worker threads (all cores)\n"
+              << "  --cache              reuse and keep tiles of the image in the tile cache\n"
+              << "                       directory (MANDELBROT_TILE_CACHE, or ./tile_cache)\n"
+              << "  --generator NAME     quadtree or scanline (quadtree)\n"
+              << "  --tile WIDTHxHEIGHT  render in tiles of this size and stream the image to the\n"
+              << "                       file, for images too big for memory (on by default, with\n"
+              << "                       1024x256 tiles, above 64 Mpixels)\n"
+              << "  --frames N           render a zoom movie of N frames, ending on the view. Each\n"
+              << "                       frame goes to its own file, named by the pattern, or to\n"
+              << "                       stdout as raw RGB24 video with - as the output\n"
+              << "  --start-width W      width of the view on the first frame of the movie (4)\n"
+              << "  --key-scale S        size of the movie's keyframes, relative to the frames (1.5)\n";
+}
+
+//reads a number with nothing else after it
+static bool readNumber(const char *text, double &value) {
+    char *end;
+    value = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+int main(int argc, char **argv) {
+    std::string center_x = "-0.5", center_y = "0";
+    double width = 0, multiple = 1, degrees = 0, number;
+    int res_width = 1920, res_height = 1080;
+    int iterations = 1000, scheme = 1, threads = 0;
+    int tile_width = 0, tile_height = 0;
+    int frames = 0;
+    double start_width = 4, key_scale = 1.5;
+    bool cache = false;
+    MandelbrotRenderer::Generator generator = MandelbrotRenderer::GENERATOR_QUADTREE;
+    std::string output;
+
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--center" && i + 2 < argc) {
+            center_x = argv[++i];
+            center_y = argv[++i];
+        } else if (arg == "--width" && has_value && readNumber(argv[i+1], width) && width > 0) {
+            i++;
+        } else if (arg == "--size" && has_value &&
+                   sscanf(argv[i+1], "%dx%d", &res_width, &res_height) == 2 &&
+                   res_width > 2 && res_height > 2) {
+            i++;
+        } else if (arg == "--tile" && has_value &&
+                   sscanf(argv[i+1], "%dx%d", &tile_width, &tile_height) == 2 &&
+                   tile_width > 2 && tile_height > 2 &&
+                   tile_width <= MandelbrotRenderer::max_resolution &&
+                   tile_height <= MandelbrotRenderer::max_resolution) {
+            i++;
+        } else if (arg == "--iterations" && has_value && readNumber(argv[i+1], number) && number >= 1) {
+            iterations = (int) number;
+            i++;
+        } else if (arg == "--scheme" && has_value && readNumber(argv[i+1], number) && number >= 1 && number <= 5) {
+            scheme = (int) number;
+            i++;
+        } else if (arg == "--color-multiple" && has_value && readNumber(argv[i+1], multiple)) {
+            i++;
+        } else if (arg == "--rotation" && has_value && readNumber(argv[i+1], degrees)) {
+            i++;
+        } else if (arg == "--threads" && has_value && readNumber(argv[i+1], number) && number >= 1) {
+            threads = (int) number;
+            i++;
+        } else if (arg == "--frames" && has_value && readNumber(argv[i+1], number) && number >= 1) {
+            frames = (int) number;
+            i++;
+        } else if (arg == "--start-width" && has_value && readNumber(argv[i+1], start_width) && start_width > 0) {
+            i++;
+        } else if (arg == "--key-scale" && has_value && readNumber(argv[i+1], key_scale) && key_scale >= 1) {
+            i++;
+        } else if (arg == "--generator" && has_value &&
+                   (std::string(argv[i+1]) == "quadtree" || std::string(argv[i+1]) == "scanline")) {
+            generator = std::string(argv[++i]) == "scanline" ? MandelbrotRenderer::GENERATOR_SCANLINE
+                                                             : MandelbrotRenderer::GENERATOR_QUADTREE;
+        } else if (arg == "--cache") {
+            cache = true;
+        } else if (arg == "--no-cache") {
+            cache = false;
+        } else if ((arg[0] != '-' || arg == "-") && output.empty()) {
+            output = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (output.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (width == 0) width = 2.0 * res_width / res_height;
+
+    //the center needs as much precision as the zoom does
+    int words = HighPrecision::wordsFor(width / res_width);
+    HighPrecision x, y;
+    if (!HighPrecision::parse(center_x, words, x) || !HighPrecision::parse(center_y, words, y)) {
+        std::cerr << "ERROR: the center has to be two decimal numbers\n";
+        return 1;
+    }
+
+    if (frames > 0) {
+        bool video = output == "-";
+        if (!video && !ZoomMovie::isFramePattern(output)) {
+            std::cerr << "ERROR: a movie needs a frame name pattern with one %d for the number and no "
+                      << "other %, like frame%05d.png, or - for stdout\n";
+            return 1;
+        }
+        ZoomMovie movie(res_width, res_height, frames);
+        movie.setKeyScale(key_scale);
+        if (movie.getKeyframeWidth() > MandelbrotRenderer::max_resolution ||
+            movie.getKeyframeHeight() > MandelbrotRenderer::max_resolution) {
+            std::cerr << "ERROR: the keyframes would be " << movie.getKeyframeWidth() << "x"
+                      << movie.getKeyframeHeight() << ", and can be at most "
+                      << MandelbrotRenderer::max_resolution << " pixels on a side. Use a smaller "
+                      << "--size or --key-scale\n";
+            return 1;
+        }
+
+        //the frames get stdout to themselves, everything else printed goes to stderr
+        FILE *out = NULL;
+        if (video) {
+            out = fdopen(dup(fileno(stdout)), "wb");
+            fflush(stdout);
+            dup2(fileno(stderr), fileno(stdout));
+        }
+
+        if (threads > 0) movie.setThreads(threads);
+        movie.setColorScheme(scheme);
+        movie.setColorMultiple(multiple);
+        movie.setIterations(iterations);
+        movie.setView(x, y, start_width, width);
+        movie.setRotation(degrees * PI / 180);
+        std::cerr << "Rendering " << frames << " frames from " << movie.getKeyframes() << " keyframes\n";
+        if (video) {
+            std::cerr << "Play it with: ffplay -f rawvideo -pixel_format rgb24 -video_size "
+                      << res_width << "x" << res_height << " -\n";
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool saved = video ? movie.renderVideo(out) : movie.renderFrames(output);
+        if (out != NULL) fclose(out);
+        if (!saved) {
+            std::cerr << "ERROR: unable to write " << output << "\n";
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Rendered " << frames << " frames in " << seconds << "s\n";
+        return 0;
+    }
+
+    bool tiled = tile_width > 0 || (double) res_width * res_height > max_untiled_pixels ||
+                 res_width > max_untiled_side || res_height > max_untiled_side;
+    if (tiled) {
+        if (tile_width == 0) {
+            tile_width = 1024;
+            tile_height = 256;
+        }
+        TiledRenderer tiles(res_width, res_height, tile_width, tile_height);
+        if (threads > 0) tiles.setThreads(threads);
+        tiles.setColorScheme(scheme);
+        tiles.setColorMultiple(multiple);
+        tiles.setIterations(iterations);
+        tiles.setView(x, y, width);
+        tiles.setRotation(degrees * PI / 180);
+        std::cout << "Rendering " << res_width << "x" << res_height << " in " << tile_width << "x"
+                  << tile_height << " tiles, using " << tiles.memoryNeeded() / 1048576 << "MB\n";
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!tiles.render(output)) {
+            std::cerr << "ERROR: unable to write " << output << "\n";
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Saved " << res_width << "x" << res_height << " image to " << output << " in "
+                  << seconds << "s\n";
+        return 0;
+    }
+
+    MandelbrotRenderer renderer(res_width, res_height);
+    if (threads > 0) renderer.setThreads(threads);
+    renderer.enableTileCache(cache);
+    renderer.setGenerator(generator);
+    renderer.setColorScheme(scheme);
+    renderer.setColorMultiple(multiple);
+    renderer.setIterations(iterations);
+    renderer.setView(x, y, width);
+    if (degrees != 0) renderer.setRotation(degrees * PI / 180);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    renderer.generate();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Rendered " << res_width << "x" << res_height << " in " << seconds << "s\n";
+
+    if (!renderer.saveImage(output)) {
+        std::cerr << "ERROR: unable to write " << output << "\n";
+        return 1;
+    }
+    std::cout << "Saved image to " << output << "\n";
+    return 0;
+}
@@ -6,7 +6,7 @@
 # define PI 3.14159265358979323846
 
 //this struct holds the parameters for the zoom function,
-//since it needs to be threaded and thus cannot accept arguments
+//which the event handlers share
 struct zoomParameters {
     MandelbrotViewer *brot;
     sf::Vector2f oldc;
@@ -14,9 +14,18 @@ struct zoomParameters {
     sf::Event event;
     double zoom;
     int frames;
-    bool done;
+    //a burst of zooming, over the old image: the notches move the target, and the
+    //view on screen glides towards it a frame at a time
+    sf::Vector2f shown_center, target_center;
+    double shown_zoom, target_zoom;
+    int glide_frames; //left in the glide
+    bool pending; //the event that ended a burst of input, to handle next
 } param;
 
+//a burst of input lasts until there's been none for this long, and then the
+//view it adds up to is rendered once
+static const std::chrono::milliseconds burst_gap(100);
+
 //returns range increments to get from min to max
 double interpolate(double min, double max, int range) { return (max-min)/range; }
 
@@ -24,11 +33,12 @@ double interpolate(double min, double max, int range) { return (max-min)/range;
 void handleEvent();
 void handleKeyboard(MandelbrotViewer *brot, sf::Event *event);
 void handleZoom(MandelbrotViewer *brot, sf::Event *event);
+bool isBurstInput(const sf::Event &event);
+void handleBurst(MandelbrotViewer *brot);
+void glide(MandelbrotViewer *brot);
 void handleDrag(MandelbrotViewer *brot, sf::Event *event);
 void handleResize(MandelbrotViewer *brot, sf::Event *event);
 double handleRotate();
-void handleGenerate();
-void eventPoll();
 void zoom();
 
 int main() {
@@ -36,20 +46,31 @@ int main() {
     //create the mandelbrotviewer instance
     MandelbrotViewer brot(820, 820);
 
-    //initialize the image
+    //start rendering the first image
     brot.resetMandelbrot();
-    brot.generate();
-    brot.updateMandelbrot();
-    brot.refreshWindow();
+    brot.startRender();
 
     //point the zoom function to the 'brot' instance
     param.brot = &brot;
-    param.done = true;
+    param.pending = false;
 
     //main window loop
     while (brot.isOpen()) {
 
-        brot.waitEvent(param.event);
+        //every frame renders in the background. Until it's done, show the passes
+        //as they're published and keep watching for input instead of blocking on
+        //the next event
+        if (param.pending) {
+            param.pending = false;
+        } else if (brot.isRendering()) {
+            if (!brot.pollEvent(param.event)) {
+                if (!brot.showProgress())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                continue;
+            }
+        } else {
+            brot.waitEvent(param.event);
+        }
 
         handleEvent();
 
@@ -60,6 +81,19 @@ int main() {
 
 //this function handles all events
 void handleEvent() {
+    //input that can change the view or the image stops a background render first.
+    //The help overlay and saving only read the front image and the view it was
+    //made for, so the render goes on
+    bool cancelled = false;
+    sf::Event::EventType type = param.event.type;
+    bool reads_only = type == sf::Event::KeyPressed &&
+        (param.event.key.code == sf::Keyboard::H || param.event.key.code == sf::Keyboard::S);
+    if ((type == sf::Event::KeyPressed && !reads_only) || type == sf::Event::MouseWheelScrolled ||
+            type == sf::Event::MouseButtonPressed || type == sf::Event::Resized ||
+            type == sf::Event::Closed) {
+        cancelled = param.brot->stopRender();
+    }
+
     //this switch statement handles all types of input
     switch (param.event.type) {
 
@@ -70,7 +104,7 @@ void handleEvent() {
 
             //if the event is a mousewheel scroll, zoom
         case sf::Event::MouseWheelScrolled:
-            handleZoom(param.brot, &param.event);
+            handleBurst(param.brot);
             break;
 
             //if the event is a click, drag the view:
@@ -96,6 +130,9 @@ void handleEvent() {
         default:
             break;
     } //end event switch
+
+    //if the event didn't render anything itself, pick the cancelled frame back up
+    if (cancelled && !param.brot->isRendering()) param.brot->resumeRender();
 }
 
 
@@ -111,30 +148,18 @@ void handleKeyboard(MandelbrotViewer *brot, sf::Event *event) {
         case sf::Keyboard::Escape:
             brot->close();
             break;
-        //if up arrow, increase iterations
+        //if up or down arrow, increase or decrease iterations
         case sf::Keyboard::Up:
-            brot->incIterations();
-            if (param.done) {
-                handleGenerate();
-                brot->updateMandelbrot();
-                brot->refreshWindow();
-            }
-            break;
-        //if down arrow, decrease iterations
         case sf::Keyboard::Down:
-            brot->decIterations();
-            if (param.done) {
-                handleGenerate();
-                brot->updateMandelbrot();
-                brot->refreshWindow();
-            }
+            handleBurst(brot);
             break;
         //if right arrow, increase color_multiple until released
         case sf::Keyboard::Right:
             color_inc = interpolate(0, 1, 25);
             while (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) {
                 brot->setColorMultiple(brot->getColorMultiple() + color_inc);
-                brot->changeColor();
+                //a frame that was cancelled takes the colors when it's finished
+                if (!brot->changeColor()) break;
                 brot->updateMandelbrot();
                 brot->refreshWindow();
             }
@@ -145,7 +170,7 @@ void handleKeyboard(MandelbrotViewer *brot, sf::Event *event) {
             while (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) {
                 if (brot->getColorMultiple() > 1) {
                     brot->setColorMultiple(brot->getColorMultiple() + color_inc);
-                    brot->changeColor();
+                    if (!brot->changeColor()) break;
                     brot->updateMandelbrot();
                     brot->refreshWindow();
                 }
@@ -175,9 +200,7 @@ void handleKeyboard(MandelbrotViewer *brot, sf::Event *event) {
         case sf::Keyboard::R:
             brot->resetMandelbrot();
             brot->resetView();
-            brot->generate();
-            brot->updateMandelbrot();
-            brot->refreshWindow();
+            brot->startRender();
             break;
         //if S, save the current image
         case sf::Keyboard::S:
@@ -187,6 +210,16 @@ void handleKeyboard(MandelbrotViewer *brot, sf::Event *event) {
         case sf::Keyboard::L:
             brot->lockColor();
             break;
+        //if I, turn the interior checks on or off and time a fresh generate
+        case sf::Keyboard::I:
+            brot->toggleInteriorChecks();
+            brot->startRender();
+            break;
+        //if G, switch between the quadtree and scanline generators and time a fresh generate
+        case sf::Keyboard::G:
+            brot->toggleGenerator();
+            brot->startRender();
+            break;
         case sf::Keyboard::H:
             brot->enableOverlay(true);
             while(true) {
@@ -222,54 +255,102 @@ void handleKeyboard(MandelbrotViewer *brot, sf::Event *event) {
     }
 }
 
-//this function handles scroll wheel input
+//this function handles scroll wheel input: a notch zooms in or out by 2 on the
+//spot under the mouse. It only moves the target of the burst, handleBurst glides
+//the view over the old image and renders the new one once the burst is over
 void handleZoom(MandelbrotViewer *brot, sf::Event *event){
 
-    //get some vectors ready to calculate the zoom
-    sf::Vector2f old_center;
-    sf::Vector2f new_center;
+    double factor;
+    if (event->mouseWheelScroll.delta > 0) factor = 0.5;
+    else if (event->mouseWheelScroll.delta < 0) factor = 2.0;
+    else return;
 
-    //zoom in with the mouse coordinates as the new center
-    //set the zoom frames up so that it is more animated
-    param.frames = 30;
-    old_center = brot->getViewCenter();
-    new_center.x = event->mouseWheelScroll.x;
-    new_center.y = event->mouseWheelScroll.y;
-
-    //if it's an upward scroll, get ready to zoom in
-    if (event->mouseWheelScroll.delta > 0) {
-        brot->changePos(brot->pixelToComplex(new_center), 0.5);
-        param.zoom = 0.5;
-    } //if it's a downward scroll, get ready to zoom out
-    else if (event->mouseWheelScroll.delta < 0) {
-        brot->changePos(brot->pixelToComplex(new_center), 2.0);
-        param.zoom = 2.0;
-    }
-
-    //set the parameters for the zoom
-    param.oldc = old_center;
-    param.newc = new_center;
+    //the mouse points at the view on screen, which may still be gliding. Find
+    //the spot it's on in the old image
+    sf::Vector2f spot;
+    spot.x = param.shown_center.x + (event->mouseWheelScroll.x - brot->getResWidth()/2.0) * param.shown_zoom;
+    spot.y = param.shown_center.y + (event->mouseWheelScroll.y - brot->getResHeight()/2.0) * param.shown_zoom;
 
-    //SFML doesn't like having a window active in more than one thread
-    brot->setWindowActive(false);
+    param.target_center = spot;
+    param.target_zoom *= factor;
+    param.glide_frames = 5;
+}
 
-    //start zooming with a worker thread, so that it can generate
-    //the new image while it's zooming
-    std::thread thread(&zoom);
+//moves the view one frame of the way to the target
+void glide(MandelbrotViewer *brot) {
+    double step = 1.0 / param.glide_frames--;
+    param.shown_center.x += (param.target_center.x - param.shown_center.x) * step;
+    param.shown_center.y += (param.target_center.y - param.shown_center.y) * step;
+    param.shown_zoom += (param.target_zoom - param.shown_zoom) * step;
+    brot->changePosView(param.shown_center, param.shown_zoom);
+    brot->refreshWindow();
+}
 
-    //start generating while it's zooming
-    brot->generate();
+//the input that gets gathered into a burst
+bool isBurstInput(const sf::Event &event) {
+    if (event.type == sf::Event::MouseWheelScrolled) return true;
+    return event.type == sf::Event::KeyPressed &&
+        (event.key.code == sf::Keyboard::Up || event.key.code == sf::Keyboard::Down);
+}
 
-    //wait for the thread to finish (wait for the zoom to finish)
-    thread.join();
+//handles param.event and the wheel notches and Up/Down presses that follow it
+//within burst_gap of each other, then moves to the view they add up to with one
+//changePos and renders it once. Any other input ends the burst early, and is
+//handled next
+void handleBurst(MandelbrotViewer *brot) {
+    //zooming starts from the whole old image
+    brot->resetView();
+    param.shown_center.x = brot->getResWidth()/2.0;
+    param.shown_center.y = brot->getResHeight()/2.0;
+    param.shown_zoom = 1.0;
+    param.target_center = param.shown_center;
+    param.target_zoom = 1.0;
+    param.glide_frames = 0;
+    bool zoomed = false;
+
+    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+    bool input = true;
+    while (true) {
+        if (input) {
+            if (param.event.type == sf::Event::MouseWheelScrolled) {
+                handleZoom(brot, &param.event);
+                zoomed = true;
+            } else if (param.event.key.code == sf::Keyboard::Up) {
+                brot->incIterations();
+            } else {
+                brot->decIterations();
+            }
+            last = std::chrono::steady_clock::now();
+        }
+        //the burst is over once it's been quiet for a while and the view caught up
+        if (param.glide_frames > 0)
+            glide(brot);
+        else if (std::chrono::steady_clock::now() - last >= burst_gap)
+            break;
 
-    //now reactivate the window
-    brot->setWindowActive(true);
+        input = false;
+        if (!brot->pollEvent(param.event)) {
+            if (param.glide_frames == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        sf::Event::EventType type = param.event.type;
+        if (isBurstInput(param.event)) {
+            input = true;
+        } else if (type != sf::Event::MouseMoved && type != sf::Event::MouseWheelMoved &&
+                   type != sf::Event::KeyReleased) {
+            param.pending = true;
+            break;
+        }
+    }
 
-    //now display the new mandelbrot
-    brot->updateMandelbrot();
-    brot->resetView();
-    brot->refreshWindow();
+    if (zoomed) {
+        //input that cut the glide short still gets the view it was going to
+        brot->changePosView(param.target_center, param.target_zoom);
+        brot->refreshWindow();
+        brot->changePos(param.target_center, param.target_zoom);
+    }
+    brot->startRender();
 }
 
 void handleDrag(MandelbrotViewer *brot, sf::Event *event) {
@@ -329,7 +410,7 @@ void handleDrag(MandelbrotViewer *brot, sf::Event *event) {
     brot->setFramerate(framerateLimit);
 
     //now regenerate the mandelbrot at the new position.
-    //This can't be threaded like zoom, because it doesn't
+    //This can't start during the drag like zoom, because it doesn't
     //know where to generate at until it's done dragging
     temp = brot->getMousePosition();
     new_position.x = temp.x;
@@ -345,17 +426,13 @@ void handleDrag(MandelbrotViewer *brot, sf::Event *event) {
     //calculate the new center
     new_center = old_center - difference;
 
-    brot->changePos(brot->pixelToComplex(new_center), 1.0);
-    brot->generate();
-    brot->resetView();
-    brot->updateMandelbrot();
-    brot->refreshWindow();
+    brot->changePos(new_center, 1.0);
+    brot->startRender();
 }
 
 //animates the zoom of the viewer (so the viewer zooms while the mandelbrot is generating)
 //uses the struct param as parameters
 void zoom() {
-    param.brot->setWindowActive(true);
     double inc_drag_x = interpolate(param.oldc.x, param.newc.x, param.frames);
     double inc_drag_y = interpolate(param.oldc.y, param.newc.y, param.frames);
     double inc_zoom = interpolate(1.0, param.zoom, param.frames);
@@ -367,7 +444,6 @@ void zoom() {
         param.brot->changePosView(param.newc, 1 + i * inc_zoom);
         param.brot->refreshWindow();
     }
-    param.brot->setWindowActive(false);
 }
 
 //rotates the view until the key is released, then returns the new rotation
@@ -407,35 +483,5 @@ void handleResize(MandelbrotViewer *brot, sf::Event *event) {
     int newX = event->size.width,
         newY = event->size.height;
     brot->resizeWindow(newX, newY);
-    brot->generate();
-    brot->updateMandelbrot();
-    brot->refreshWindow();
-}
-
-void handleGenerate() {
-    //start checking for events in a separate thread
-    param.done = false;
-    std::thread thread(eventPoll);
-    thread.detach();
-
-    //start generating
-    param.brot->generate();
-    param.done = true; //signal the eventPoll thread to return
-}
-
-void eventPoll() {
-    while(!param.done) {
-        if (param.brot->pollEvent(param.event)) {
-            if (param.event.type == sf::Event::KeyPressed && (param.event.key.code == sf::Keyboard::Up ||
-                        param.event.key.code == sf::Keyboard::Down)) {
-                //if input is found:
-                //handle the interrupt,
-                handleEvent();
-                //send the generation an interrupt,
-                param.brot->restartGeneration();
-            }
-        }
-        //sleep a bit so that the processor doesn't spike checking for events
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    brot->startRender();
 }
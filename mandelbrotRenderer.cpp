@@ -0,0 +1,1707 @@
+#include "mandelbrotRenderer.h"
+#include "imageWriter.h"
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <math.h>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <ctime>
+#include <algorithm>
+#include <chrono>
+
+# define PI 3.14159265358979323846
+
+//below this many pixels per unit of center magnitude, doubles can't tell the pixels
+//apart well enough and double-double takes over. Below the second limit the same
+//happens to double-double, and deep zoom takes over
+static const double double_double_limit = 1e-13;
+static const double deep_zoom_limit = 1e-28;
+
+//the colors the palettes are made from
+static const Color black = {0, 0, 0, 255};
+static const Color white = {255, 255, 255, 255};
+static const Color red = {255, 0, 0, 255};
+static const Color green = {0, 255, 0, 255};
+static const Color blue = {0, 0, 255, 255};
+static const Color yellow = {255, 255, 0, 255};
+static const Color magenta = {255, 0, 255, 255};
+static const Color cyan = {0, 255, 255, 255};
+static const Color orange = {255, 165, 0, 255};
+
+//frames that should take less than this many seconds don't get preview passes
+static const double preview_time = 0.033;
+
+//how many tiles the cache keeps in memory (16KB each), and how many files it keeps
+//on disk and where. MANDELBROT_TILE_CACHE overrides the directory
+static const unsigned int memory_tiles = 4096;
+static const unsigned int disk_tiles = 8192;
+static const char *tile_directory = "tile_cache";
+//tiles are only shared between views whose pixels are within 1/4096 of a pixel
+//of the same grid
+static const double tile_phase_steps = 4096;
+
+//the biggest color lookup table, in colors (64MB)
+static const unsigned int max_color_lut = 1 << 24;
+
+//Constructor
+MandelbrotRenderer::MandelbrotRenderer(int resX, int resY) {
+    if (resX < 1 || resY < 1 || resX > max_resolution || resY > max_resolution)
+        throw std::invalid_argument("MandelbrotRenderer: images can be at most 65536 pixels on a side");
+    res_width = resX;
+    res_height = resY;
+
+    //initialize the images
+    pixels.assign((size_t) res_width * res_height * 4, 255);
+    front_pixels = pixels;
+    image_version = 0;
+    scheme = 1;
+
+    //initialize the color palette. resetMandelbrot sizes it, max_iter isn't set yet
+    color_locked = false;
+    std::vector<int> pal_row;
+    palette.push_back(pal_row);
+    palette.push_back(pal_row);
+    palette.push_back(pal_row);
+    color_lut_dirty = true;
+    rotation = 0;
+    epoch = 0;
+    frame_epoch = 0;
+    reference_count = 0;
+    references_reserved = 0;
+
+    //initialize the mandelbrot parameters
+    resetMandelbrot();
+    shown_view = currentView();
+
+    //initialize the image_array
+    image_array.resize(res_width, res_height);
+    resetOrbits();
+
+    //get the number of supported concurrent threads
+    max_threads = std::thread::hardware_concurrency();
+
+    //pick the fastest escape kernel this CPU can run
+    escape_kernel = selectEscapeKernel();
+    double_double_kernel = selectDoubleDoubleKernel();
+    color_kernel = selectColorKernel();
+    kernel_reported = false;
+    tile_progress = false;
+    publishing_tiles = false;
+    interior_checks = true;
+    generator = GENERATOR_QUADTREE;
+
+    const char *directory = getenv("MANDELBROT_TILE_CACHE");
+    tile_cache.reset(new TileCache(directory ? directory : tile_directory, memory_tiles, disk_tiles));
+    use_tile_cache = true;
+
+    verbose = true;
+
+    stats_log = NULL;
+    const char *log = getenv("MANDELBROT_STATS_LOG");
+    if (log) setStatsLog(log);
+}
+
+MandelbrotRenderer::~MandelbrotRenderer() {
+    if (stats_log != NULL) fclose(stats_log);
+}
+
+static inline double secondsSince(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//throw away all the saved orbits, and size the orbit and sample arrays to match the image
+void MandelbrotRenderer::resetOrbits() {
+    Orbit none;
+    none.x = NAN;
+    none.y = NAN;
+    orbit_array.assign((size_t) res_width * res_height, none);
+    sampled.assign((size_t) res_width * res_height, 0);
+    samples_seeded = false;
+    filled_squares.clear();
+    orbits_valid = false;
+    frame_complete = false;
+}
+
+//moves a res_width by res_height array so that (row, column) gets what was at
+//(row + dy, column + dx), filling what comes in from outside
+template <typename T>
+static void shiftArray(std::vector<T> &v, int width, int height, int dx, int dy, const T &fill) {
+    int kept = width - abs(dx);
+    for (int n=0; n<height; n++) {
+        int i = dy > 0 ? n : height - 1 - n;
+        T *row = &v[(size_t) i * width];
+        int source = i + dy;
+        if (source < 0 || source >= height) {
+            std::fill(row, row + width, fill);
+            continue;
+        }
+        T *from = &v[(size_t) source * width];
+        if (dx >= 0) {
+            std::copy(from + dx, from + width, row);
+            std::fill(row + kept, row + width, fill);
+        } else {
+            std::copy_backward(from, from + kept, row + width);
+            std::fill(row, row - dx, fill);
+        }
+    }
+}
+
+void MandelbrotRenderer::shiftSamples(int dx, int dy) {
+    Orbit none;
+    none.x = NAN;
+    none.y = NAN;
+    image_array.shift(dx, dy);
+    shiftArray(orbit_array, res_width, res_height, dx, dy, none);
+    shiftArray(sampled, res_width, res_height, dx, dy, (unsigned char) 0);
+    samples_seeded = true;
+    frame_complete = false;
+
+    //a filled square is still right if all of its border stayed on screen, so
+    //its inside doesn't need escaping again. The rest are dropped
+    for (unsigned int w=0; w<filled_squares.size(); w++) {
+        std::vector<Square> &squares = filled_squares[w];
+        unsigned int kept = 0;
+        for (unsigned int k=0; k<squares.size(); k++) {
+            long long min_x = (long long) squares[k].min_x - dx, max_x = (long long) squares[k].max_x - dx;
+            long long min_y = (long long) squares[k].min_y - dy, max_y = (long long) squares[k].max_y - dy;
+            if (min_x < 0 || min_y < 0 || max_x >= res_width || max_y >= res_height) continue;
+            Square square;
+            square.min_x = min_x;
+            square.max_x = max_x;
+            square.min_y = min_y;
+            square.max_y = max_y;
+            squares[kept++] = square;
+            for (long long i=min_y+1; i<max_y; i++) {
+                unsigned char *row = &sampled[(size_t) i * res_width];
+                for (long long j=min_x+1; j<max_x; j++) {
+                    if (!row[j]) row[j] = sample_filled;
+                }
+            }
+        }
+        squares.resize(kept);
+    }
+
+    //the pixels that moved in have no old count to reuse
+    orbits_valid = false;
+}
+
+void MandelbrotRenderer::scaleSamples(int ax, int ay, double zoom_factor) {
+    std::vector<unsigned int> old_counts((size_t) res_width * res_height);
+    for (int i=0; i<res_height; i++) {
+        for (int j=0; j<res_width; j++) {
+            old_counts[(size_t) i * res_width + j] = image_array.get(i, j);
+        }
+    }
+    Orbit none;
+    none.x = NAN;
+    none.y = NAN;
+    std::vector<Orbit> old_orbits((size_t) res_width * res_height, none);
+    old_orbits.swap(orbit_array);
+    std::vector<unsigned char> old_sampled((size_t) res_width * res_height, 0);
+    old_sampled.swap(sampled);
+
+    //new pixel (column, row) is old pixel (ax + column*zoom_factor, ay + row*zoom_factor).
+    //Zooming in only every 2nd (or 4th) row and column lands on an old pixel
+    int step = zoom_factor < 1 ? (int) (1 / zoom_factor) : 1;
+    for (int i=0; i<res_height; i += step) {
+        int old_row = ay + (int) (i * zoom_factor);
+        if (old_row < 0 || old_row >= res_height) continue;
+        for (int j=0; j<res_width; j += step) {
+            int old_column = ax + (int) (j * zoom_factor);
+            if (old_column < 0 || old_column >= res_width) continue;
+            size_t from = (size_t) old_row * res_width + old_column;
+            size_t to = (size_t) i * res_width + j;
+            if (old_sampled[from] != sample_exact) continue;
+            image_array.set(i, j, old_counts[from]);
+            orbit_array[to] = old_orbits[from];
+            sampled[to] = sample_exact;
+        }
+    }
+    samples_seeded = true;
+    filled_squares.clear();
+    orbits_valid = false;
+    frame_complete = false;
+}
+
+//keep the double precision area centered on the high precision center
+void MandelbrotRenderer::updateArea() {
+    area.left = center_x.toDoubleDouble() - area.width/2.0;
+    area.top = center_y.toDoubleDouble() - area.height/2.0;
+    updateBasis();
+}
+
+//the pixel steps are the rotated unit vectors scaled to a pixel, and the origin is
+//the rotated top left corner. Without rotation that's exactly area.left and area.top
+void MandelbrotRenderer::updateBasis() {
+    double c = cos(rotation), s = sin(rotation);
+    step_column.x = c * area_inc;
+    step_column.y = s * area_inc;
+    step_row.x = -s * area_inc;
+    step_row.y = c * area_inc;
+    if (rotation == 0) {
+        basis_origin.x = area.left;
+        basis_origin.y = area.top;
+    } else {
+        Point<double> corner;
+        corner.x = -res_width/2.0 * area_inc;
+        corner.y = -res_height/2.0 * area_inc;
+        corner = rotateOffset(corner);
+        basis_origin.x = center_x.toDoubleDouble() + corner.x;
+        basis_origin.y = center_y.toDoubleDouble() + corner.y;
+    }
+}
+
+void MandelbrotRenderer::incIterations() {
+    restartGeneration();
+    //if iterations is in the hundreds, add 100
+    //if iterations is in the thousands, add 1000, etc.
+    int magnitude = (int) log10(temp_max_iter.load());
+    unsigned int inc = pow(10, magnitude);
+    temp_max_iter.fetch_add(inc);
+}
+
+void MandelbrotRenderer::decIterations() {
+    restartGeneration();
+    //if iterations is in the hundreds, subtract 100
+    //if iterations is in the thousands, subtract 1000, etc.
+    if (temp_max_iter.load() > 100) {
+        int magnitude = (int) log10(temp_max_iter.load());
+        unsigned int dec = pow(10, magnitude);
+        if (dec == temp_max_iter.load()) dec /= 10;
+        temp_max_iter.fetch_sub(dec);
+    }
+}
+
+//this is a setter function to change the color scheme
+//it also recolors the image
+void MandelbrotRenderer::setColorScheme(int newScheme) {
+    scheme = newScheme;
+    initPalette();
+    changeColor();
+}
+
+//sets the rotation. The next generate draws it
+void MandelbrotRenderer::setRotation(double radians) {
+    restartGeneration();
+    rotation = radians;
+    if (rotation >= 2 * PI) rotation -= 2 * PI;
+    else if (rotation < 0) rotation += 2 * PI;
+    updateBasis();
+    orbits_valid = false;
+    samples_seeded = false;
+}
+
+//unlocking recolors the image with a palette fitted to max_iter again
+void MandelbrotRenderer::lockColor() {
+    if (color_locked) {
+        color_locked = false;
+        initPalette();
+        changeColor();
+    } else {
+        color_locked = true;
+    }
+}
+
+//the images are identical either way, so there is nothing to redraw. The saved
+//orbits are forgotten so the next generate really iterates every pixel again
+void MandelbrotRenderer::toggleInteriorChecks() {
+    interior_checks = !interior_checks;
+    orbits_valid = false;
+    samples_seeded = false;
+    if (verbose) std::cout << "Interior checks " << (interior_checks ? "on" : "off") << "\n";
+}
+
+//switches between the quadtree and scanline generators. Like the interior
+//checks, the saved orbits are forgotten so the next generate can be timed
+void MandelbrotRenderer::toggleGenerator() {
+    generator = generator == GENERATOR_QUADTREE ? GENERATOR_SCANLINE : GENERATOR_QUADTREE;
+    orbits_valid = false;
+    samples_seeded = false;
+    if (verbose) std::cout << "Using the " << (generator == GENERATOR_SCANLINE ? "scanline" : "quadtree") << " generator\n";
+}
+
+//Functions to change parameters of mandelbrot
+
+//regenerates the image with the new color multiplier, without regenerating
+//the mandelbrot
+bool MandelbrotRenderer::changeColor() {
+    if (!frame_complete) return false;
+    colorImage();
+    publishImage();
+    return true;
+}
+
+//the table is only rebuilt when something it depends on has changed. Returns
+//false if max_iter is too big for one
+bool MandelbrotRenderer::updateColorLut() {
+    unsigned int max = max_iter.load();
+    if (max >= max_color_lut) return false;
+    if (!color_lut_dirty && color_lut_multiple == color_multiple && color_lut_max_iter == max)
+        return true;
+
+    color_lut.resize(max + 1);
+    for (unsigned int i=0; i<=max; i++) {
+        Color color = findColor(i);
+        memcpy(&color_lut[i], &color, sizeof(uint32_t));
+    }
+    color_lut_dirty = false;
+    color_lut_multiple = color_multiple;
+    color_lut_max_iter = max;
+    return true;
+}
+
+void MandelbrotRenderer::colorRows(int first_row, int rows, bool use_lut) {
+    for (int i=first_row; i<first_row + rows; i++) {
+        colorSpan(i, 0, res_width, use_lut);
+    }
+}
+
+void MandelbrotRenderer::colorSpan(int row, int column, int count, bool use_lut) {
+    if (use_lut) {
+        bool compact = image_array.isCompact();
+        uint32_t *out = (uint32_t *) &pixels[((size_t) row * res_width + column) * 4];
+        const void *iters = compact ? (const void *) (image_array.rowPointer<uint16_t>(row) + column)
+                                    : (const void *) (image_array.rowPointer<uint32_t>(row) + column);
+        color_kernel(iters, compact, count, color_lut.data(), color_lut_max_iter, out);
+    } else {
+        for (int j=column; j<column + count; j++) {
+            setPixel(j, row, findColor(image_array.get(row, j)));
+        }
+    }
+}
+
+void MandelbrotRenderer::colorImage() {
+    bool use_lut = updateColorLut();
+    ThreadPool &threads = renderPool();
+    if (threads.size() <= 1) {
+        colorRows(0, res_height, use_lut);
+        return;
+    }
+    //a few bands per thread, so the threads finish together
+    int bands = std::min((int) threads.size() * 4, res_height);
+    std::vector< std::future<void> > jobs;
+    for (int i=0; i<bands; i++) {
+        int first = res_height * i / bands;
+        int rows = res_height * (i + 1) / bands - first;
+        jobs.push_back(threads.submit(std::bind(&MandelbrotRenderer::colorRows, this, first, rows, use_lut)));
+    }
+    for (unsigned int i=0; i<jobs.size(); i++) {
+        jobs[i].wait();
+    }
+}
+
+//changes the parameters of the mandelbrot: sets new center (in pixel coordinates
+//of the current image) and zooms accordingly. does not regenerate or update the image
+void MandelbrotRenderer::changePos(double x, double y, double zoom_factor) {
+    restartGeneration();
+    Point<double> new_center;
+    new_center.x = x;
+    new_center.y = y;
+
+    //the old counts can be carried over from a finished frame, or from the samples
+    //an unfinished one kept
+    bool keep = orbits_valid || samples_seeded;
+
+    //zooming by 2 or 4 can line the new pixels up with the old ones, if the center
+    //is moved (by less than a pixel) so that pixel 0 of the new image is on an old
+    //pixel: new pixel c is old pixel a + c*zoom_factor, with a a whole number
+    bool scaling = (zoom_factor == 0.25 || zoom_factor == 0.5 || zoom_factor == 2.0 ||
+                    zoom_factor == 4.0) && rotation == 0 && keep;
+    int align_x = 0, align_y = 0;
+    if (scaling) {
+        align_x = (int) floor(new_center.x - zoom_factor * res_width/2.0 + 0.5);
+        align_y = (int) floor(new_center.y - zoom_factor * res_height/2.0 + 0.5);
+        new_center.x = align_x + zoom_factor * res_width/2.0;
+        new_center.y = align_y + zoom_factor * res_height/2.0;
+    }
+
+    //how far the new center is from the old one, rotated like the image
+    Point<double> offset;
+    offset.x = (new_center.x - res_width/2.0) * area_inc;
+    offset.y = (new_center.y - res_height/2.0) * area_inc;
+    offset = rotateOffset(offset);
+
+    //a move by whole pixels without rotation keeps the pixels lined up with the
+    //last image, so all of it that stays on screen can be kept
+    double shift_x = new_center.x - res_width/2.0;
+    double shift_y = new_center.y - res_height/2.0;
+    bool shifting = zoom_factor == 1.0 && rotation == 0 && keep &&
+                    shift_x == floor(shift_x) && shift_y == floor(shift_y) &&
+                    fabs(shift_x) < res_width && fabs(shift_y) < res_height;
+
+    area.width = area.width * zoom_factor;
+    area.height = area.height * zoom_factor;
+    area_inc = (area.width/res_width).toDouble();
+
+    //move the center, keeping enough precision for the new zoom
+    int words = HighPrecision::wordsFor(area_inc);
+    center_x.setPrecision(words);
+    center_y.setPrecision(words);
+    center_x += HighPrecision(offset.x, words);
+    center_y += HighPrecision(offset.y, words);
+    updateArea();
+
+    if (shifting) {
+        shiftSamples((int) shift_x, (int) shift_y);
+    } else if (scaling) {
+        scaleSamples(align_x, align_y, zoom_factor);
+    } else {
+        orbits_valid = false;
+        samples_seeded = false;
+    }
+    //NOTE: this is a relative zoom
+}
+
+void MandelbrotRenderer::setView(const HighPrecision &x, const HighPrecision &y, double width) {
+    restartGeneration();
+    area_inc = width / res_width;
+    area.width = area_inc * res_width;
+    area.height = area_inc * res_height;
+
+    int words = HighPrecision::wordsFor(area_inc);
+    center_x = x;
+    center_y = y;
+    center_x.setPrecision(words);
+    center_y.setPrecision(words);
+    updateArea();
+
+    orbits_valid = false;
+    samples_seeded = false;
+}
+
+//changes the resolution, keeping the center and the size of a pixel
+bool MandelbrotRenderer::resize(int new_x, int new_y) {
+    if (new_x < 1 || new_y < 1 || new_x > max_resolution || new_y > max_resolution) return false;
+    restartGeneration();
+
+    res_width = new_x;
+    res_height = new_y;
+
+    //calculate the new area around the same center
+    area.width = area_inc * res_width;
+    area.height = area_inc * res_height;
+    area_inc = (area.width/res_width).toDouble();
+    updateArea();
+
+    //resize the images and the image_array
+    {
+        ViewInfo view = currentView();
+        std::lock_guard<std::mutex> lock(mutex_image);
+        pixels.assign((size_t) res_width * res_height * 4, 0);
+        for (size_t i=3; i<pixels.size(); i += 4) pixels[i] = 255;
+        front_pixels = pixels;
+        shown_view = view;
+        image_version.fetch_add(1);
+    }
+    image_array.resize(res_width, res_height);
+    resetOrbits();
+    return true;
+}
+
+//the pool is only remade when the number of threads changes
+ThreadPool &MandelbrotRenderer::renderPool() {
+    unsigned int threads = std::max(max_threads, 1u);
+    if (!pool || pool->size() != threads) pool.reset(new ThreadPool(threads));
+    return *pool;
+}
+
+//generate the mandelbrot
+void MandelbrotRenderer::generate(bool show_passes) {
+    generateFor(epoch.load(), show_passes);
+}
+
+void MandelbrotRenderer::generateFor(unsigned int frame, bool show_passes) {
+    frame_epoch = frame;
+    quadtree_master(show_passes);
+}
+
+//this is a private worker thread function. Each thread claims the next row of
+//pixels, generates it, then starts the next one
+void MandelbrotRenderer::genLine(int worker) {
+    WorkerStats &counters = worker_stats[worker];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<unsigned int> iters(res_width);
+
+    while (!cancelled()) {
+        if (worker == 0 && publishing_tiles) publishTiles();
+        int row = next_line.fetch_add(1);
+        if (row >= res_height) break;
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        escapeLine(row, 0, 0, 1, res_width, iters.data());
+        for (int column = 0; column < res_width; column++) {
+            image_array.set(row, column, iters[column]);
+        }
+        Square done;
+        done.min_x = 0;
+        done.max_x = res_width - 1;
+        done.min_y = row;
+        done.max_y = row;
+        finishRegion(worker, done);
+        double compute = secondsSince(begin);
+        counters.compute += compute;
+        counters.busy += compute;
+    }
+    counters.idle = secondsSince(start);
+}
+
+//runs the coarse passes. A pass is only worth painting if the frame is slow,
+//so the passes stop as soon as it looks like the full image won't take long
+bool MandelbrotRenderer::generatePreviews(bool show_passes) {
+    //after a drag, a cancelled frame or a tile cache hit most of the image is
+    //known already, and passes over it would only escape pixels it has the counts
+    //for and make it look blocky
+    bool seeded = samples_seeded;
+    if (!seeded) sampled.assign((size_t) res_width * res_height, 0);
+    samples_seeded = false;
+    bool published = false;
+    if (seeded) return published;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ThreadPool &threads = renderPool();
+    for (int step = 8; step > 1 && !cancelled(); step /= 2) {
+        next_pass_row.store(0);
+        std::vector< std::future<void> > jobs;
+        for (unsigned int i=0; i<threads.size(); i++) {
+            jobs.push_back(threads.submit(std::bind(&MandelbrotRenderer::genPass, this, step)));
+        }
+        for (unsigned int i=0; i<jobs.size(); i++) {
+            jobs[i].wait();
+        }
+        if (cancelled()) return published;
+
+        //a pass escapes 1 in step*step pixels, so this guesses how long it would
+        //take to do them all. Frames faster than a couple of screen refreshes
+        //don't need a preview
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed * step * step < preview_time) return published;
+
+        paintPass(step);
+        publishImage();
+        published = true;
+        if (show_passes) passFinished();
+    }
+    return published;
+}
+
+//a worker thread function for the coarse passes: takes the next row of the pass
+//and escapes every step'th pixel of it, until the pass is done
+void MandelbrotRenderer::genPass(int step) {
+    std::vector<unsigned int> iters(res_width / step + 1);
+    int count = (res_width - 1) / step + 1;
+
+    while (!cancelled()) {
+        int row = next_pass_row.fetch_add(step);
+        if (row >= res_height) break;
+
+        escapeLine(row, 0, 0, step, count, iters.data());
+        for (int i=0; i<count; i++) {
+            image_array.set(row, i * step, iters[i]);
+        }
+    }
+}
+
+//paints every sample of the pass as a step by step block, with the sample in
+//the top left corner
+void MandelbrotRenderer::paintPass(int step) {
+    for (int row = 0; row < res_height; row += step) {
+        int rows = std::min(step, res_height - row);
+        for (int column = 0; column < res_width; column += step) {
+            Color color = findColor(image_array.get(row, column));
+            int columns = std::min(step, res_width - column);
+            for (int i=0; i<rows; i++) {
+                for (int j=0; j<columns; j++) {
+                    setPixel(column + j, row + i, color);
+                }
+            }
+        }
+    }
+}
+
+//the back image is always drawn in full before it's published (the passes paint
+//every pixel, and so does coloring), so what the swap leaves in it never shows
+void MandelbrotRenderer::publishImage() {
+    ViewInfo view = currentView();
+    std::lock_guard<std::mutex> lock(mutex_image);
+    pixels.swap(front_pixels);
+    shown_view = view;
+    image_version.fetch_add(1);
+}
+
+MandelbrotRenderer::ViewInfo MandelbrotRenderer::currentView() {
+    ViewInfo view;
+    view.tier = tier;
+    view.references = reference_count.load();
+    view.skip = view.references > 0 ? references[0]->skip : 0;
+    view.center_x = center_x;
+    view.center_y = center_y;
+    view.area = area;
+    view.area_inc = area_inc;
+    view.max_iter = max_iter.load();
+    view.rotation = rotation;
+    return view;
+}
+
+//Reset/update functions:
+
+//resets the mandelbrot to generate the starting area
+void MandelbrotRenderer::resetMandelbrot() {
+    restartGeneration();
+    area.height = 2;
+    area_inc = (area.height/res_height).toDouble();
+    area.width = area_inc * res_width;
+    center_x = HighPrecision(-0.5, HighPrecision::wordsFor(area_inc));
+    center_y = HighPrecision(0.0, HighPrecision::wordsFor(area_inc));
+    updateArea();
+
+    max_iter.store(100);
+    last_max_iter.store(100);
+    temp_max_iter.store(100);
+    orbits_valid = false;
+    samples_seeded = false;
+    frame_complete = false;
+    tier = TIER_DOUBLE;
+    color_multiple = 1;
+    rotation = 0;
+    updateBasis();
+    color_locked = false;
+    initPalette();
+}
+
+//saves the image, as a png if the filename ends in .png and a ppm otherwise
+bool MandelbrotRenderer::saveImage(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(mutex_image);
+    return writeImage(filename, front_pixels.data(), res_width, res_height);
+}
+
+//adds up the escape-times of the image, with max_iter for the pixels in the set
+unsigned long long MandelbrotRenderer::countIterations() {
+    unsigned long long total = 0;
+    unsigned int limit = max_iter.load();
+    for (int i=0; i<res_height; i++) {
+        for (int j=0; j<res_width; j++) {
+            total += std::min(image_array.get(i, j), limit);
+        }
+    }
+    return total;
+}
+
+//Converts a vector from pixel coordinates to the corresponding
+//coordinates on the complex plane, through the pixel basis
+Point<DoubleDouble> MandelbrotRenderer::pixelToComplex(double column, double row) {
+    Point<DoubleDouble> comp;
+    comp.x = basis_origin.x + twoProd(column, step_column.x);
+    comp.y = basis_origin.y + twoProd(row, step_row.y);
+    //the cross terms are zero without rotation, skipping them keeps those views exact
+    if (rotation) {
+        comp.x = comp.x + twoProd(row, step_row.x);
+        comp.y = comp.y + twoProd(column, step_column.y);
+    }
+    return comp;
+}
+
+//this function calculates the escape-time of the given coordinate
+//it is the brain of the mandelbrot program: it does the work to
+//make the pretty pictures :)
+int MandelbrotRenderer::escape(int row, int column) {
+    unsigned int iter;
+    escapeLine(row, column, 0, 1, 1, &iter);
+    return iter;
+}
+
+//this calculates the escape-time of a line of pixels. Pixels that can reuse their
+//old value are filled in directly, the rest are handed to the escape kernel together
+void MandelbrotRenderer::escapeLine(int row, int column, int d_row, int d_column, int count, unsigned int *out) {
+
+    //scratch space for the batch, kept around so it isn't reallocated for every line
+    static thread_local std::vector<double> batch_x;
+    static thread_local std::vector<double> batch_y;
+    static thread_local std::vector<double> batch_zx;
+    static thread_local std::vector<double> batch_zy;
+    static thread_local std::vector<DoubleDouble> batch_dd_x;
+    static thread_local std::vector<DoubleDouble> batch_dd_y;
+    static thread_local std::vector<unsigned int> batch_iter;
+    static thread_local std::vector<unsigned int> batch_start;
+    static thread_local std::vector<int> batch_index;
+    batch_x.clear();
+    batch_y.clear();
+    batch_dd_x.clear();
+    batch_dd_y.clear();
+    batch_zx.clear();
+    batch_zy.clear();
+    batch_iter.clear();
+    batch_index.clear();
+
+    //read the iteration counts once instead of for every pixel
+    unsigned int max = max_iter.load();
+    unsigned int last = last_max_iter.load();
+    //the old counts only mean something if they're a finished image of this view
+    bool reuse = orbits_valid;
+
+    int start_row = row, start_column = column;
+    unsigned long long reused = 0;
+    for (int i=0; i<count; i++, row += d_row, column += d_column) {
+        size_t index = (size_t) row * res_width + column;
+        unsigned int old = image_array.get(row, column);
+        Orbit &orbit = orbit_array[index];
+
+        //check if an earlier pass already did this pixel
+        if (sampled[index]) {
+            out[i] = old;
+            reused++;
+        }
+        //check if we increased iterations and if the pixel already diverged
+        else if (reuse && last < max && old < last) {
+            out[i] = old;
+            reused++;
+        }
+        //check if we decreased iterations and if the pixel already converged
+        else if (reuse && last > max && old > max) {
+            out[i] = old;
+            reused++;
+        }
+        //if not, queue it up for the escape-time algorithm
+        else {
+            Point<double> point;
+            if (tier == TIER_DOUBLE) {
+                //convert from pixel to complex coordinates
+                Point<DoubleDouble> complex = pixelToComplex(column, row);
+                point.x = complex.x.toDouble();
+                point.y = complex.y.toDouble();
+            } else {
+                //the deeper tiers work with offsets from the center, the absolute
+                //coordinates would get lost in rounding
+                double offset_column = column - res_width/2.0;
+                double offset_row = row - res_height/2.0;
+                point.x = offset_column * step_column.x + offset_row * step_row.x;
+                point.y = offset_column * step_column.y + offset_row * step_row.y;
+
+                //double-double can hold the absolute coordinates again
+                if (tier == TIER_DOUBLE_DOUBLE) {
+                    batch_dd_x.push_back(center_dd.x + point.x);
+                    batch_dd_y.push_back(center_dd.y + point.y);
+                }
+            }
+
+            batch_x.push_back(point.x);
+            batch_y.push_back(point.y);
+            batch_index.push_back(i);
+
+            //if the pixel stopped at an earlier max_iter, carry on from there
+            //(only doubles save their orbits)
+            if (reuse && tier == TIER_DOUBLE && !std::isnan(orbit.x) && old <= max) {
+                batch_zx.push_back(orbit.x);
+                batch_zy.push_back(orbit.y);
+                batch_iter.push_back(old);
+            } else {
+                batch_zx.push_back(0);
+                batch_zy.push_back(0);
+                batch_iter.push_back(0);
+            }
+        }
+    }
+
+    if (reused) stat_reused.fetch_add(reused, std::memory_order_relaxed);
+    if (batch_index.empty()) return;
+    batch_start.assign(batch_iter.begin(), batch_iter.end());
+
+    bool escaped = true;
+    if (tier == TIER_DEEP)
+        escaped = escapeDeep(batch_x.data(), batch_y.data(), batch_iter.data(), batch_index.size(), max);
+    else if (tier == TIER_DOUBLE_DOUBLE)
+        double_double_kernel(batch_dd_x.data(), batch_dd_y.data(), batch_iter.data(),
+                             batch_index.size(), max);
+    else
+        escape_kernel(batch_x.data(), batch_y.data(), batch_zx.data(), batch_zy.data(),
+                      batch_iter.data(), batch_index.size(), max, interior_checks);
+
+    //deep zoom gives up part way through when the frame is cancelled, so none of
+    //the batch is marked as sampled for the next frame
+    if (!escaped) {
+        for (unsigned int i=0; i<batch_index.size(); i++) out[batch_index[i]] = 0;
+        return;
+    }
+
+    unsigned long long iterations = 0, interior = 0;
+    for (unsigned int i=0; i<batch_index.size(); i++) {
+        int index = batch_index[i];
+        out[index] = batch_iter[i];
+
+        //the interior checks stop at max_iter with a NaN orbit, without saying
+        //how far they got
+        if (tier == TIER_DOUBLE && batch_iter[i] >= max && std::isnan(batch_zx[i]))
+            interior++;
+        else
+            iterations += batch_iter[i] - batch_start[i];
+
+        //save where the orbit stopped, or forget it if the pixel escaped
+        size_t pixel = (size_t) (start_row + index*d_row) * res_width + start_column + index*d_column;
+        sampled[pixel] = sample_exact;
+        Orbit &orbit = orbit_array[pixel];
+        if (batch_iter[i] >= max && tier == TIER_DOUBLE) {
+            orbit.x = batch_zx[i];
+            orbit.y = batch_zy[i];
+        } else {
+            orbit.x = NAN;
+        }
+    }
+    stat_escaped.fetch_add(batch_index.size(), std::memory_order_relaxed);
+    stat_iterations.fetch_add(iterations, std::memory_order_relaxed);
+    if (interior) stat_interior.fetch_add(interior, std::memory_order_relaxed);
+}
+
+//this calculates the escape-time of a batch of points given as offsets from the
+//center, by perturbation from the reference orbits. Points that glitch on one
+//reference are tried on the next, and when they run out a new reference is put
+//on the first glitched point (which can't glitch on its own reference). If the
+//frame runs out of references, the points left are finished on the closest one,
+//glitches and all. Doubles can't be used instead, at this zoom they'd all be the center
+bool MandelbrotRenderer::escapeDeep(const double *offset_x, const double *offset_y, unsigned int *iters,
+                                  int count, unsigned int max) {
+
+    static thread_local std::vector<int> todo;
+    static thread_local std::vector<int> glitches;
+    static thread_local std::vector<double> batch_x;
+    static thread_local std::vector<double> batch_y;
+    static thread_local std::vector<unsigned int> batch_iter;
+    static thread_local std::vector<char> batch_glitched;
+
+    todo.resize(count);
+    for (int i=0; i<count; i++) todo[i] = i;
+
+    for (unsigned int r=0; !todo.empty(); r++) {
+        ReferenceOrbit *ref = getReference(r);
+        if (ref == NULL) ref = addReference(r, offset_x[todo[0]], offset_y[todo[0]], max);
+
+        //a cancelled frame doesn't need the rest
+        if (ref == NULL && cancelled()) return false;
+
+        //if the frame is out of references, do the best there is for what's left
+        if (ref == NULL) {
+            escapeClosest(todo, offset_x, offset_y, iters, r, max);
+            break;
+        }
+
+        //the points relative to this reference
+        batch_x.resize(todo.size());
+        batch_y.resize(todo.size());
+        batch_iter.resize(todo.size());
+        batch_glitched.resize(todo.size());
+        for (unsigned int i=0; i<todo.size(); i++) {
+            batch_x[i] = offset_x[todo[i]] - ref->offset_x;
+            batch_y[i] = offset_y[todo[i]] - ref->offset_y;
+        }
+        perturbationKernel(*ref, batch_x.data(), batch_y.data(), batch_iter.data(),
+                           batch_glitched.data(), todo.size(), max);
+
+        //keep the good ones, and try the glitched ones again on the next reference
+        glitches.clear();
+        for (unsigned int i=0; i<todo.size(); i++) {
+            if (batch_glitched[i]) glitches.push_back(todo[i]);
+            else iters[todo[i]] = batch_iter[i];
+        }
+        todo.swap(glitches);
+    }
+    return true;
+}
+
+//escapeDeep's last resort: each of the points in todo is iterated on whichever of
+//the first count references is closest to it, without stopping at glitches. The
+//count can be off past the glitch, but it's usually close
+void MandelbrotRenderer::escapeClosest(const std::vector<int> &todo, const double *offset_x,
+                                       const double *offset_y, unsigned int *iters,
+                                       unsigned int count, unsigned int max) {
+    static thread_local std::vector<int> closest;
+    static thread_local std::vector<int> points;
+    static thread_local std::vector<double> batch_x;
+    static thread_local std::vector<double> batch_y;
+    static thread_local std::vector<unsigned int> batch_iter;
+
+    closest.assign(todo.size(), 0);
+    for (unsigned int i=0; i<todo.size(); i++) {
+        double best = INFINITY;
+        for (unsigned int r=0; r<count; r++) {
+            double dx = offset_x[todo[i]] - references[r]->offset_x;
+            double dy = offset_y[todo[i]] - references[r]->offset_y;
+            if (dx*dx + dy*dy < best) {
+                best = dx*dx + dy*dy;
+                closest[i] = r;
+            }
+        }
+    }
+
+    for (unsigned int r=0; r<count; r++) {
+        points.clear();
+        batch_x.clear();
+        batch_y.clear();
+        for (unsigned int i=0; i<todo.size(); i++) {
+            if (closest[i] != (int) r) continue;
+            points.push_back(todo[i]);
+            batch_x.push_back(offset_x[todo[i]] - references[r]->offset_x);
+            batch_y.push_back(offset_y[todo[i]] - references[r]->offset_y);
+        }
+        if (points.empty()) continue;
+        batch_iter.resize(points.size());
+        perturbationKernel(*references[r], batch_x.data(), batch_y.data(), batch_iter.data(),
+                           NULL, points.size(), max);
+        for (unsigned int i=0; i<points.size(); i++) iters[points[i]] = batch_iter[i];
+    }
+}
+
+ReferenceOrbit *MandelbrotRenderer::getReference(unsigned int i) {
+    if (i < reference_count.load(std::memory_order_acquire)) return references[i].get();
+    return NULL;
+}
+
+//the references are made in order: a thread only asks for slot i once slots
+//0 to i-1 are done, so slot i is either being made already or is the next one
+ReferenceOrbit *MandelbrotRenderer::addReference(unsigned int i, double offset_x, double offset_y, unsigned int max) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_references);
+
+        //another thread might be making it, or have made it while this one waited
+        while (i < references_reserved && i >= reference_count.load())
+            reference_ready.wait(lock);
+        if (i < reference_count.load()) return references[i].get();
+        if (references_reserved >= max_references) return NULL;
+        references_reserved++;
+    }
+
+    std::unique_ptr<ReferenceOrbit> ref(new ReferenceOrbit);
+    ref->offset_x = offset_x;
+    ref->offset_y = offset_y;
+    int words = center_x.getPrecision();
+    bool done = computeReferenceOrbit(*ref, center_x + HighPrecision(offset_x, words),
+                                      center_y + HighPrecision(offset_y, words), max,
+                                      std::bind(&MandelbrotRenderer::cancelled, this));
+
+    //a cancelled one gives the slot back, for any thread still waiting on it
+    std::lock_guard<std::mutex> lock(mutex_references);
+    ReferenceOrbit *made = NULL;
+    if (done) {
+        made = ref.get();
+        references[i] = std::move(ref);
+        reference_count.store(i + 1, std::memory_order_release);
+    } else {
+        references_reserved = i;
+    }
+    reference_ready.notify_all();
+    return made;
+}
+
+//picks the precision tier for the current view: doubles until the pixels get too
+//small for them compared to the center, then double-double, then deep zoom. In deep
+//zoom this also calculates the reference orbit at the center for this frame
+void MandelbrotRenderer::updatePrecisionTier() {
+    double magnitude = std::max(1.0, std::max(fabs(center_x.toDouble()), fabs(center_y.toDouble())));
+    if (area_inc >= double_double_limit * magnitude) tier = TIER_DOUBLE;
+    else if (area_inc >= deep_zoom_limit * magnitude) tier = TIER_DOUBLE_DOUBLE;
+    else tier = TIER_DEEP;
+
+    center_dd.x = center_x.toDoubleDouble();
+    center_dd.y = center_y.toDoubleDouble();
+
+    //nothing else is generating yet, so the slots can be emptied without the lock
+    for (unsigned int i=0; i<references_reserved; i++) references[i].reset();
+    reference_count.store(0);
+    references_reserved = 0;
+    if (tier == TIER_DEEP) {
+        std::unique_ptr<ReferenceOrbit> ref(new ReferenceOrbit);
+        ref->offset_x = 0;
+        ref->offset_y = 0;
+        //a cancelled frame goes without, the escapes give up on it too
+        if (!computeReferenceOrbit(*ref, center_x, center_y, max_iter.load(),
+                                   std::bind(&MandelbrotRenderer::cancelled, this)))
+            return;
+
+        //probe the corners and the middle of the edges of the view to find out
+        //how many iterations the series approximation can skip
+        std::vector<double> probe_x, probe_y;
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<3; j++) {
+                if (i == 1 && j == 1) continue;
+                Point<double> probe;
+                probe.x = (j * (res_width-1) / 2.0 - res_width/2.0) * area_inc;
+                probe.y = (i * (res_height-1) / 2.0 - res_height/2.0) * area_inc;
+                probe = rotateOffset(probe);
+                probe_x.push_back(probe.x);
+                probe_y.push_back(probe.y);
+            }
+        }
+        computeSeriesApproximation(*ref, probe_x.data(), probe_y.data(), probe_x.size(), max_iter.load());
+        if (verbose) printf("Series approximation skips %u iterations\n", ref->skip);
+
+        references[0] = std::move(ref);
+        references_reserved = 1;
+        reference_count.store(1);
+    }
+}
+
+//findColor uses the number of iterations passed to it to look up a color in the palette
+Color MandelbrotRenderer::findColor(unsigned int iter) {
+    int i = (int) fmod(iter * color_multiple, palette[0].size());
+    Color color;
+    if (iter >= max_iter.load()) color = black;
+    else if (iter == 0) {
+        color = white;
+    } else {
+        color.r = palette[0][i];
+        color.g = palette[1][i];
+        color.b = palette[2][i];
+        color.a = 255;
+    }
+    return color;
+}
+
+void MandelbrotRenderer::setPixel(int column, int row, Color color) {
+    unsigned char *pixel = &pixels[((size_t) row * res_width + column) * 4];
+    pixel[0] = color.r;
+    pixel[1] = color.g;
+    pixel[2] = color.b;
+    pixel[3] = color.a;
+}
+
+//rotates an offset from the center by the current rotation. It never touches the
+//absolute coordinates, so it keeps its precision in deep zooms
+Point<double> MandelbrotRenderer::rotateOffset(Point<double> offset) {
+    Point<double> rotated;
+    rotated.x = offset.x * cos(rotation) - offset.y * sin(rotation);
+    rotated.y = offset.x * sin(rotation) + offset.y * cos(rotation);
+    return rotated;
+}
+
+//Sets up the palette array
+void MandelbrotRenderer::initPalette() {
+
+    color_lut_dirty = true;
+
+    //if the color is locked, it shouldn't resize the palette
+    //(that would change the color scale)
+    if (!color_locked) {
+        palette[0].resize(max_iter.load());
+        palette[1].resize(max_iter.load());
+        palette[2].resize(max_iter.load());
+    }
+
+    switch (scheme) {
+        //scheme one is black:blue:white:orange:black
+        case 1:
+            smoosh(black, blue, 0, 0.25);
+            smoosh(blue, white, 0.25, 0.56);
+            smoosh(white, orange, 0.56, 0.75);
+            smoosh(orange, black, 0.75, 1);
+            break;
+        //scheme two is black:red:orange:black
+        case 2:
+            smoosh(black, red, 0, 0.7);
+            smoosh(red, orange, 0.7, 0.84);
+            smoosh(orange, black, 0.84, 1);
+            break;
+        //scheme three is black:cyan:white:black
+        case 3:
+            smoosh(black, cyan, 0, 0.43);
+            smoosh(cyan, white, 0.43, 0.86);
+            smoosh(white, black, 0.86, 1);
+            break;
+        //scheme four is red:orange:yellow:green:blue:magenta:red
+        case 4:
+            smoosh(red, orange, 0, 0.17);
+            smoosh(orange, yellow, 0.17, 0.33);
+            smoosh(yellow, green, 0.33, 0.5);
+            smoosh(green, blue, 0.5, 0.67);
+            smoosh(blue, magenta, 0.67, 0.83);
+            smoosh(magenta, red, 0.83, 1);
+            break;
+        //scheme five is black:white
+        case 5:
+            smoosh(white, black, 0, 1);
+            break;
+    }
+}
+
+//Smooshes two colors together, and writes them to the palette in the specified range
+void MandelbrotRenderer::smoosh(Color c1, Color c2, float min_per, float max_per) {
+    int min = (int) (min_per * palette[0].size());
+    int max = (int) (max_per * palette[0].size());
+    int range = max-min;
+
+    double r_inc = interpolate(c1.r, c2.r, range);
+    double g_inc = interpolate(c1.g, c2.g, range);
+    double b_inc = interpolate(c1.b, c2.b, range);
+
+    //loop through the palette setting new colors
+    for (int i=0; i < range; i++) {
+        palette[0][min+i] = (int) (c1.r + i * r_inc);
+        palette[1][min+i] = (int) (c1.g + i * g_inc);
+        palette[2][min+i] = (int) (c1.b + i * b_inc);
+    }
+}
+
+//a region's counts are final once it's listed, the lock hands them to worker 0
+void MandelbrotRenderer::finishRegion(int worker, const Square &region) {
+    if (!publishing_tiles) return;
+    FinishedRegions &regions = *finished_regions[worker];
+    std::lock_guard<std::mutex> lock(regions.mutex);
+    regions.squares.push_back(region);
+}
+
+//only worker 0 calls this, and it's the only thread drawing into the back image
+//until the frame is colored. The back image is copied rather than swapped, since
+//the parts that aren't finished still show the pass
+void MandelbrotRenderer::publishTiles() {
+    if (secondsSince(last_tile_publish) < preview_time) return;
+    last_tile_publish = std::chrono::steady_clock::now();
+
+    regions_to_color.clear();
+    for (unsigned int i=0; i<finished_regions.size(); i++) {
+        std::lock_guard<std::mutex> lock(finished_regions[i]->mutex);
+        std::vector<Square> &squares = finished_regions[i]->squares;
+        regions_to_color.insert(regions_to_color.end(), squares.begin(), squares.end());
+        squares.clear();
+    }
+    //a region listed after a cancel can hold counts a deep escape gave up on
+    if (regions_to_color.empty() || cancelled()) return;
+
+    bool use_lut = updateColorLut();
+    ViewInfo view = currentView();
+    for (unsigned int i=0; i<regions_to_color.size(); i++) {
+        const Square &region = regions_to_color[i];
+        for (unsigned int row = region.min_y; row <= region.max_y; row++) {
+            colorSpan(row, region.min_x, region.max_x - region.min_x + 1, use_lut);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_image);
+    std::copy(pixels.begin(), pixels.end(), front_pixels.begin());
+    shown_view = view;
+    image_version.fetch_add(1);
+}
+
+// Quadtree generator
+
+//squares go through the deques packed into 64 bits, 16 bits per coordinate. That's
+//why images can't be more than max_resolution (65536) pixels on a side
+static inline uint64_t packSquare(const Square &r_square) {
+    return (uint64_t) r_square.min_x | (uint64_t) r_square.max_x << 16 |
+           (uint64_t) r_square.min_y << 32 | (uint64_t) r_square.max_y << 48;
+}
+static inline Square unpackSquare(uint64_t task) {
+    Square square;
+    square.min_x = task & 0xFFFF;
+    square.max_x = (task >> 16) & 0xFFFF;
+    square.min_y = (task >> 32) & 0xFFFF;
+    square.max_y = (task >> 48) & 0xFFFF;
+    return square;
+}
+
+void MandelbrotRenderer::quadtree_createOutsideImage() {
+    // Generate horizontal lines of image
+    if (!quadtree_escapeEdge(0, 0, 0, 1, res_width)) return;
+    if (!quadtree_escapeEdge(res_height-1, 0, 0, 1, res_width)) return;
+    // Generate vertical lines of image
+    if (res_height > 2) {
+        if (!quadtree_escapeEdge(1, 0, 1, 0, res_height-2)) return;
+        if (!quadtree_escapeEdge(1, res_width-1, 1, 0, res_height-2)) return;
+    }
+
+    // Create first square to check
+    Square firstSquare; // Outer edge of image
+    firstSquare.min_x = 0;
+    firstSquare.min_y = 0;
+    firstSquare.max_x = res_width-1;
+    firstSquare.max_y = res_height-1;
+    quadtree_push(0, firstSquare);
+}
+// The border is escaped by the calling thread alone, so on a slow frame it's done
+// in chunks to notice a cancel
+bool MandelbrotRenderer::quadtree_escapeEdge(int row, int column, int d_row, int d_column, int count) {
+    static const int chunk = 256;
+    unsigned int iters[chunk];
+    for (int done = 0; done < count; done += chunk) {
+        if (cancelled()) return false;
+        int n = std::min(chunk, count - done);
+        escapeLine(row, column, d_row, d_column, n, iters);
+        for (int i=0; i<n; i++, row += d_row, column += d_column) {
+            setPixel(column, row, findColor(iters[i]));
+            image_array.set(row, column, iters[i]);
+        }
+    }
+    return !cancelled();
+}
+void MandelbrotRenderer::quadtree_push(int worker, const Square &r_square) {
+    // Squares without any inside pixels are already done
+    if (r_square.max_x - r_square.min_x < 2 || r_square.max_y - r_square.min_y < 2) {
+        finishRegion(worker, r_square);
+        return;
+    }
+
+    quadtree_pending++;
+    if (!quadtree_deques[worker]->push(packSquare(r_square))) {
+        // The deque is full, so do it right away
+        quadtree_process(worker, r_square);
+        quadtree_finish();
+        return;
+    }
+
+    // Wake up a sleeping worker to come and steal it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (quadtree_sleeping.load() != 0) {
+        std::lock_guard<std::mutex> lock(mutex_quadtree_sleep);
+        quadtree_wake.notify_one();
+    }
+}
+bool MandelbrotRenderer::quadtree_steal(int worker, Square &r_square) {
+    // Go around the other workers, starting with the next one
+    int workers = quadtree_deques.size();
+    uint64_t task;
+    for (int i=1; i<workers; i++) {
+        if (quadtree_deques[(worker + i) % workers]->steal(task)) {
+            r_square = unpackSquare(task);
+            return true;
+        }
+    }
+    return false;
+}
+void MandelbrotRenderer::quadtree_finish() {
+    // The last square wakes everyone up so they can return
+    if (--quadtree_pending == 0) {
+        std::lock_guard<std::mutex> lock(mutex_quadtree_sleep);
+        quadtree_wake.notify_all();
+    }
+}
+bool MandelbrotRenderer::quadtree_allEmpty() {
+    for (unsigned int i=0; i<quadtree_deques.size(); i++) {
+        if (!quadtree_deques[i]->looksEmpty()) return false;
+    }
+    return true;
+}
+void MandelbrotRenderer::quadtree_process(int worker, const Square &r_square) {
+    WorkerStats &counters = worker_stats[worker];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    counters.squares++;
+
+    // If the whole border is the same, so is the inside
+    unsigned int iterCount = image_array.get(r_square.min_y, r_square.min_x);
+    bool toSplit = !image_array.rowEquals(r_square.min_y, r_square.min_x, r_square.max_x, iterCount) ||
+                   !image_array.rowEquals(r_square.max_y, r_square.min_x, r_square.max_x, iterCount) ||
+                   !image_array.columnEquals(r_square.min_x, r_square.min_y+1, r_square.max_y-1, iterCount) ||
+                   !image_array.columnEquals(r_square.max_x, r_square.min_y+1, r_square.max_y-1, iterCount);
+    std::chrono::steady_clock::time_point checked = std::chrono::steady_clock::now();
+    double check = std::chrono::duration<double>(checked - start).count();
+    counters.check += check;
+
+    if (!toSplit) {
+        image_array.fillRect(r_square.min_x+1, r_square.min_y+1, r_square.max_x-1, r_square.max_y-1, iterCount);
+        for (unsigned int i=r_square.min_y+1; i<r_square.max_y; i++) {
+            Orbit *row = &orbit_array[(size_t) i * res_width];
+            for (unsigned int j=r_square.min_x+1; j<r_square.max_x; j++) {
+                row[j].x = NAN;
+            }
+        }
+        double fill = secondsSince(checked);
+        counters.fill += fill;
+        counters.busy += check + fill;
+        counters.filled += (size_t) (r_square.max_x - r_square.min_x - 1) * (r_square.max_y - r_square.min_y - 1);
+        filled_squares[worker].push_back(r_square);
+        finishRegion(worker, r_square);
+        return;
+    }
+    counters.splits++;
+
+    // Split it with a plus through the middle
+    unsigned int mid_x = (r_square.max_x + r_square.min_x)/2;
+    unsigned int mid_y = (r_square.max_y + r_square.min_y)/2;
+    static thread_local std::vector<unsigned int> vertical;
+    static thread_local std::vector<unsigned int> horizontal;
+
+    // Vertical
+    vertical.resize(r_square.max_y - r_square.min_y - 1);
+    escapeLine(r_square.min_y+1, mid_x, 1, 0, vertical.size(), vertical.data());
+    // Horizontal, in two halves since the middle point is already in the vertical line.
+    // Escaping it twice would continue its orbit twice when increasing iterations
+    horizontal.resize(r_square.max_x - r_square.min_x - 1);
+    unsigned int left = mid_x - r_square.min_x - 1;
+    escapeLine(mid_y, r_square.min_x+1, 0, 1, left, horizontal.data());
+    horizontal[left] = vertical[mid_y - r_square.min_y - 1];
+    escapeLine(mid_y, mid_x+1, 0, 1, horizontal.size() - left - 1, horizontal.data() + left + 1);
+
+    for (unsigned int i=0; i<vertical.size(); i++) {
+        image_array.set(r_square.min_y+i+1, mid_x, vertical[i]);
+    }
+    for (unsigned int i=0; i<horizontal.size(); i++) {
+        image_array.set(mid_y, r_square.min_x+i+1, horizontal[i]);
+    }
+    double compute = secondsSince(checked);
+    counters.compute += compute;
+    counters.busy += check + compute;
+
+    // Queue up the four quarters
+    Square temp = r_square;
+    // Top left
+    temp.max_x = mid_x;
+    temp.max_y = mid_y;
+    quadtree_push(worker, temp);
+    // Bottom left
+    temp.min_y = mid_y;
+    temp.max_y = r_square.max_y;
+    quadtree_push(worker, temp);
+    // Bottom right
+    temp.min_x = mid_x;
+    temp.max_x = r_square.max_x;
+    quadtree_push(worker, temp);
+    // Top Right
+    temp.min_y = r_square.min_y;
+    temp.max_y = mid_y;
+    quadtree_push(worker, temp);
+}
+void MandelbrotRenderer::quadtree_master(bool show_passes) {
+    std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+    RenderStats frame;
+
+    // Read out what the iteration count should be. Samples kept from before were
+    // escaped to the old count
+    unsigned int temp = temp_max_iter.load();
+    if (temp != max_iter.load()) {
+        max_iter.store(temp);
+        initPalette();
+        samples_seeded = false;
+    }
+    //the kernel is only worth saying once, and not before setVerbose has had a chance
+    if (verbose && !kernel_reported) {
+        std::cout << "Using the " << escapeKernelName(escape_kernel) << " escape kernel\n";
+        kernel_reported = true;
+    }
+    if (verbose) printf("Starting generate at iteration: %u\n",max_iter.load());
+    frame_complete = false;
+    //the old counts are still needed to skip pixels, setCompact keeps them
+    image_array.setCompact(max_iter.load() < 65536);
+    updatePrecisionTier();
+
+    // One deque per worker, the calling thread is worker 0
+    unsigned int workers = std::max(max_threads, 1u);
+    while (quadtree_deques.size() < workers)
+        quadtree_deques.push_back(std::unique_ptr<WorkStealingDeque>(new WorkStealingDeque()));
+    quadtree_deques.resize(workers);
+    for (unsigned int i=0; i<workers; i++) {
+        quadtree_deques[i]->clear();
+    }
+    filled_squares.resize(workers);
+    for (unsigned int i=0; i<workers; i++) {
+        filled_squares[i].clear();
+    }
+    quadtree_pending.store(0);
+    quadtree_sleeping.store(0);
+
+    WorkerStats zero;
+    memset(&zero, 0, sizeof(zero));
+    worker_stats.assign(workers, zero);
+    stat_escaped.store(0);
+    stat_reused.store(0);
+    stat_interior.store(0);
+    stat_iterations.store(0);
+
+    // Anything the tile cache knows doesn't need escaping again
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    loadTiles();
+    frame.cache_seconds = secondsSince(start);
+
+    // Coarse passes first, for a quick look at slow frames
+    start = std::chrono::steady_clock::now();
+    bool previewed = generatePreviews(show_passes);
+    frame.preview_seconds = secondsSince(start);
+
+    // A frame slow enough for a preview also shows its finished regions. The back
+    // image starts as the last pass, and they're colored in over it
+    publishing_tiles = tile_progress && previewed && !cancelled();
+    if (publishing_tiles) {
+        while (finished_regions.size() < workers)
+            finished_regions.push_back(std::unique_ptr<FinishedRegions>(new FinishedRegions()));
+        for (unsigned int i=0; i<finished_regions.size(); i++) {
+            finished_regions[i]->squares.clear();
+        }
+        std::lock_guard<std::mutex> lock(mutex_image);
+        std::copy(front_pixels.begin(), front_pixels.end(), pixels.begin());
+        last_tile_publish = std::chrono::steady_clock::now();
+    }
+
+    ThreadPool &threads = renderPool();
+    std::vector< std::future<void> > jobs;
+    if (generator == GENERATOR_SCANLINE) {
+        // Every row in full, the calling thread is worker 0 again
+        next_line.store(0);
+        for (unsigned int i=1; i<workers; i++) {
+            jobs.push_back(threads.submit(std::bind(&MandelbrotRenderer::genLine, this, i)));
+        }
+        genLine(0);
+    } else {
+        // Generate the outer edge, this queues the first square
+        start = std::chrono::steady_clock::now();
+        quadtree_createOutsideImage();
+        frame.border_seconds = secondsSince(start);
+
+        for (unsigned int i=1; i<workers; i++) {
+            jobs.push_back(threads.submit(std::bind(&MandelbrotRenderer::quadtree_worker, this, i)));
+        }
+        quadtree_worker(0);
+    }
+    for (unsigned int i=0; i<jobs.size(); i++) {
+        jobs[i].wait();
+    }
+    publishing_tiles = false;
+
+    // If we ended early, return before we draw half an image. Every pixel escaped
+    // so far is marked in sampled, so the next frame of this view (or a drag or
+    // a 2x zoom of it) starts from them
+    if (cancelled()) {
+        if (verbose) printf("Restarted gen!\n");
+        last_max_iter.store( max_iter.load() );
+        orbits_valid = false;
+        samples_seeded = true;
+        frame.total_seconds = secondsSince(frame_start);
+        finishStats(frame, false);
+        return;
+    }
+
+    start = std::chrono::steady_clock::now();
+    colorImage();
+    publishImage();
+    frame_complete = true;
+    frame.color_seconds = secondsSince(start);
+    if (verbose) printf("created image\n");
+    last_max_iter.store( max_iter.load() );
+    orbits_valid = true;
+
+    start = std::chrono::steady_clock::now();
+    storeTiles();
+    frame.cache_seconds += secondsSince(start);
+    frame.total_seconds = secondsSince(frame_start);
+    finishStats(frame, true);
+}
+
+void MandelbrotRenderer::finishStats(RenderStats &frame, bool finished) {
+    static const char *tier_names[] = {"double", "double-double", "deep"};
+    frame.width = res_width;
+    frame.height = res_height;
+    frame.max_iter = max_iter.load();
+    frame.tier = tier_names[tier];
+    frame.generator = generator == GENERATOR_SCANLINE ? "scanline" : "quadtree";
+    frame.finished = finished;
+    frame.escaped = stat_escaped.load();
+    frame.reused = stat_reused.load();
+    frame.interior = stat_interior.load();
+    frame.iterations = stat_iterations.load();
+    for (unsigned int i=0; i<worker_stats.size(); i++) {
+        const WorkerStats &counters = worker_stats[i];
+        frame.compute_seconds += counters.compute;
+        frame.check_seconds += counters.check;
+        frame.fill_seconds += counters.fill;
+        frame.squares += counters.squares;
+        frame.splits += counters.splits;
+        frame.filled += counters.filled;
+        frame.busy_seconds.push_back(counters.busy);
+        //quadtree_worker leaves its whole time in idle, the rest is waiting
+        frame.idle_seconds.push_back(std::max(counters.idle - counters.busy, 0.0));
+    }
+
+    if (verbose) {
+        printf("Frame took %.1f ms: %llu pixels escaped, %llu filled, %.3g iterations\n",
+               frame.total_seconds * 1000, frame.escaped, frame.filled, (double) frame.iterations);
+    }
+    if (stats_log != NULL) {
+        fprintf(stats_log, "%s\n", frame.toJson().c_str());
+        fflush(stats_log);
+    }
+    std::lock_guard<std::mutex> lock(mutex_image);
+    stats = frame;
+}
+
+RenderStats MandelbrotRenderer::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_image);
+    return stats;
+}
+
+bool MandelbrotRenderer::setStatsLog(const std::string &filename) {
+    if (stats_log != NULL) fclose(stats_log);
+    stats_log = NULL;
+    if (filename.empty()) return true;
+    stats_log = fopen(filename.c_str(), "a");
+    return stats_log != NULL;
+}
+
+//the grid has one point per pixel, numbered from an anchor: the center rounded
+//down to a power of two about 2^40 pixels wide. Numbering from the anchor keeps
+//the grid numbers small at any zoom, and views that are moved by whole pixels
+//get the same anchor and grid (unless they cross a multiple of 2^40 pixels).
+//Views that aren't a whole number of pixels apart have a different phase (the
+//fraction of a pixel left over), which goes into the key
+bool MandelbrotRenderer::tileGrid(long long &grid_x, long long &grid_y, std::string &prefix) {
+    if (!use_tile_cache || rotation != 0) return false;
+
+    int exponent = (int) ceil(log2(area_inc)) + 40;
+    HighPrecision anchor_x = center_x.truncated(exponent);
+    HighPrecision anchor_y = center_y.truncated(exponent);
+
+    //where pixel (0, 0) is, in pixels from the anchor
+    DoubleDouble first_x = (center_x - anchor_x).toDoubleDouble() / area_inc - DoubleDouble(res_width/2.0);
+    DoubleDouble first_y = (center_y - anchor_y).toDoubleDouble() / area_inc - DoubleDouble(res_height/2.0);
+
+    long long phase[2];
+    long long *grid[2] = {&grid_x, &grid_y};
+    DoubleDouble first[2] = {first_x, first_y};
+    for (int i=0; i<2; i++) {
+        double whole = floor(first[i].hi);
+        double fraction = (first[i] - DoubleDouble(whole)).toDouble();
+        if (fraction < 0) {
+            whole -= 1;
+            fraction += 1;
+        }
+        phase[i] = (long long) floor(fraction * tile_phase_steps + 0.5);
+        if (phase[i] == tile_phase_steps) {
+            whole += 1;
+            phase[i] = 0;
+        }
+        *grid[i] = (long long) whole;
+    }
+
+    //the pixel size goes in exactly, as the bits of the double
+    uint64_t inc_bits;
+    memcpy(&inc_bits, &area_inc, sizeof(inc_bits));
+    std::ostringstream key;
+    key << anchor_x.toHex() << ',' << anchor_y.toHex() << ',' << std::hex << inc_bits << std::dec
+        << ',' << phase[0] << ',' << phase[1] << ',' << max_iter.load() << ',';
+    prefix = key.str();
+    return true;
+}
+
+std::string MandelbrotRenderer::tileKey(const std::string &prefix, long long tile_x, long long tile_y) {
+    std::ostringstream key;
+    key << prefix << tile_x << ',' << tile_y;
+    return key.str();
+}
+
+//rounds towards negative infinity, so tiles left of the anchor work too
+static long long tileOf(long long grid) {
+    long long size = TileCache::tile_size;
+    return grid >= 0 ? grid / size : -((-grid + size - 1) / size);
+}
+
+void MandelbrotRenderer::loadTiles() {
+    long long grid_x, grid_y;
+    std::string prefix;
+    if (!tileGrid(grid_x, grid_y, prefix)) return;
+
+    //the loaded counts go in as samples, like the ones a drag keeps
+    if (!samples_seeded) sampled.assign((size_t) res_width * res_height, 0);
+    Orbit none;
+    none.x = NAN;
+    none.y = NAN;
+
+    int size = TileCache::tile_size;
+    long long first_x = tileOf(grid_x), last_x = tileOf(grid_x + res_width - 1);
+    long long first_y = tileOf(grid_y), last_y = tileOf(grid_y + res_height - 1);
+    std::vector<uint32_t> counts(size * size);
+    unsigned int loaded = 0, tiles = 0;
+
+    for (long long ty = first_y; ty <= last_y; ty++) {
+        for (long long tx = first_x; tx <= last_x; tx++) {
+            tiles++;
+            if (!tile_cache->load(tileKey(prefix, tx, ty), counts.data())) continue;
+            loaded++;
+
+            //the part of the tile that's on screen
+            int min_x = std::max(0LL, tx * size - grid_x);
+            int max_x = std::min((long long) res_width, (tx + 1) * size - grid_x);
+            int min_y = std::max(0LL, ty * size - grid_y);
+            int max_y = std::min((long long) res_height, (ty + 1) * size - grid_y);
+            for (int i=min_y; i<max_y; i++) {
+                const uint32_t *row = &counts[(i + grid_y - ty * size) * size];
+                for (int j=min_x; j<max_x; j++) {
+                    uint32_t count = row[j + grid_x - tx * size];
+                    if (!(count & 0x80000000u)) continue;
+                    size_t index = (size_t) i * res_width + j;
+                    image_array.set(i, j, count & 0x7fffffffu);
+                    orbit_array[index] = none;
+                    sampled[index] = sample_exact;
+                }
+            }
+        }
+    }
+    if (loaded > 0) {
+        samples_seeded = true;
+        if (verbose) printf("Loaded %u of %u tiles from the cache\n", loaded, tiles);
+    }
+}
+
+//the frame's exact counts are added to the tiles that are already cached, so
+//tiles on the edge of the screen fill in as more of them is seen. A tile is only
+//written when the frame added something to it. Once the view moves on, the rest
+//aren't worth the time
+void MandelbrotRenderer::storeTiles() {
+    long long grid_x, grid_y;
+    std::string prefix;
+    if (!tileGrid(grid_x, grid_y, prefix)) return;
+
+    int size = TileCache::tile_size;
+    long long first_x = tileOf(grid_x), last_x = tileOf(grid_x + res_width - 1);
+    long long first_y = tileOf(grid_y), last_y = tileOf(grid_y + res_height - 1);
+    std::vector<uint32_t> counts(size * size);
+
+    for (long long ty = first_y; ty <= last_y && !cancelled(); ty++) {
+        for (long long tx = first_x; tx <= last_x; tx++) {
+            std::string key = tileKey(prefix, tx, ty);
+            if (!tile_cache->load(key, counts.data())) std::fill(counts.begin(), counts.end(), 0);
+
+            int min_x = std::max(0LL, tx * size - grid_x);
+            int max_x = std::min((long long) res_width, (tx + 1) * size - grid_x);
+            int min_y = std::max(0LL, ty * size - grid_y);
+            int max_y = std::min((long long) res_height, (ty + 1) * size - grid_y);
+            bool added = false;
+            for (int i=min_y; i<max_y; i++) {
+                uint32_t *row = &counts[(i + grid_y - ty * size) * size];
+                for (int j=min_x; j<max_x; j++) {
+                    uint32_t &count = row[j + grid_x - tx * size];
+                    if (count & 0x80000000u || sampled[(size_t) i * res_width + j] != sample_exact) continue;
+                    count = image_array.get(i, j) | 0x80000000u;
+                    added = true;
+                }
+            }
+            if (added) tile_cache->store(key, counts.data());
+        }
+    }
+}
+
+void MandelbrotRenderer::quadtree_worker(int worker) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t task;
+    Square square;
+    while (!cancelled()) {
+        if (worker == 0 && publishing_tiles) publishTiles();
+
+        // Work on our own squares first, newest first, then steal the oldest ones
+        if (quadtree_deques[worker]->pop(task)) {
+            quadtree_process(worker, unpackSquare(task));
+            quadtree_finish();
+            continue;
+        }
+        if (quadtree_steal(worker, square)) {
+            quadtree_process(worker, square);
+            quadtree_finish();
+            continue;
+        }
+        if (quadtree_pending.load() == 0)
+            break;
+
+        // Nothing to steal right now, but other workers are still splitting squares.
+        // The timeout only matters when restarting, every push wakes a sleeper
+        std::unique_lock<std::mutex> lock(mutex_quadtree_sleep);
+        quadtree_sleeping++;
+        while (quadtree_pending.load() != 0 && !cancelled() && quadtree_allEmpty())
+            quadtree_wake.wait_for(lock, std::chrono::milliseconds(10));
+        quadtree_sleeping--;
+    }
+    worker_stats[worker].idle = secondsSince(start);
+}
+// End Quadtree generator
@@ -0,0 +1,457 @@
+#ifndef MANDELBROTRENDERER_H
+#define MANDELBROTRENDERER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include "escapeKernel.h"
+#include "colorKernel.h"
+#include "highPrecision.h"
+#include "perturbation.h"
+#include "iterationBuffer.h"
+#include "workStealingDeque.h"
+#include "threadPool.h"
+#include "tileCache.h"
+#include "renderStats.h"
+
+struct Color {
+    unsigned char r;
+    unsigned char g;
+    unsigned char b;
+    unsigned char a;
+};
+// A point, or an offset, on the complex plane
+template <typename T>
+struct Point {
+    T x;
+    T y;
+};
+// A rectangle of the complex plane
+struct Area {
+    DoubleDouble left, top, width, height;
+};
+// Where a pixel's orbit stopped when it hit max_iter, x is NaN if there is none
+struct Orbit {
+    double x;
+    double y;
+};
+// Quadtree structs
+struct Square {
+    unsigned int min_x, max_x, min_y, max_y; // Inclusive, outer border will already be written
+};
+// End Quadtree structs
+
+//MandelbrotRenderer does all of the work of making an image of the mandelbrot:
+//the view, escape-times, the precision tiers, the generators and the coloring.
+//It has no window, the image is a block of RGBA pixels, so it can render on a
+//machine with no display. MandelbrotViewer puts a window around it
+class MandelbrotRenderer {
+    public:
+        //the ways to generate an image: the quadtree fills in every square whose
+        //border is all one count, and the scanline generator escapes every row in
+        //full, which wins when nearly every pixel is different
+        enum Generator { GENERATOR_QUADTREE, GENERATOR_SCANLINE };
+
+        //the biggest image the quadtree can work on, in pixels on a side
+        static const int max_resolution = 65536;
+
+        //This constructor creates a new renderer with specified resolution. It
+        //throws std::invalid_argument if a side is over max_resolution
+        MandelbrotRenderer(int res_x, int res_y);
+        virtual ~MandelbrotRenderer();
+
+        //Accesor functions:
+        int getResWidth() {return res_width;}
+        int getResHeight() {return res_height;}
+        int getIters() {return max_iter.load();}
+        double getRotation() {return rotation;}
+        double getColorMultiple() {return color_multiple;}
+        bool isColorLocked() {return color_locked;}
+        bool areInteriorChecksOn() {return interior_checks;}
+        Generator getGenerator() {return generator;}
+        //the image, res_width * res_height RGBA pixels, row after row. This is the
+        //front image: the last finished frame or preview pass. Generation draws
+        //into a back image and swaps it to the front when it's complete, so a
+        //window can read this (holding mutex_image) while a frame renders
+        const unsigned char *getPixels() {return front_pixels.data();}
+        //the iterations a plain render of the image would do: every pixel's
+        //escape-time added up. Interior checks and reused samples make the real
+        //work less
+        unsigned long long countIterations();
+        //what the last generate did and how long it took
+        RenderStats getStats();
+
+        //Setter functions:
+        void incIterations();
+        void decIterations();
+        void setIterations(int iter) {temp_max_iter.store(iter); initPalette(); restartGeneration();}
+        void setColorMultiple(double mult) {color_multiple = mult;}
+        void setColorScheme(int newScheme);
+        void setRotation(double radians);
+        void setThreads(unsigned int threads) {max_threads = threads;}
+        //starts a new epoch, which stops the frame being generated. Changing the
+        //view or the iterations does this too
+        void restartGeneration() {epoch.fetch_add(1);}
+        void lockColor();
+        void toggleInteriorChecks();
+        void setGenerator(Generator gen) {generator = gen;}
+        void toggleGenerator();
+        void enableTileCache(bool enable) {use_tile_cache = enable;}
+        //turns the progress messages printed during generate on or off
+        void setVerbose(bool enable) {verbose = enable;}
+        //with tile progress on, frames slow enough for preview passes also publish
+        //the parts of the image the generator has finished as they come in
+        void setTileProgress(bool enable) {tile_progress = enable;}
+        //appends the stats of every frame to filename, one line of JSON each.
+        //An empty name stops it
+        bool setStatsLog(const std::string &filename);
+
+        //Functions to change parameters for mandelbrot generation:
+        //recolors the finished frame. Returns false if there isn't one, and the
+        //colors are used when the frame being generated is done
+        bool changeColor();
+        //moves the center to (x, y) in pixel coordinates and zooms by zoom_factor
+        void changePos(double x, double y, double zoom_factor);
+        //centers the view on (x, y), width wide on the complex plane
+        void setView(const HighPrecision &x, const HighPrecision &y, double width);
+        //returns false, and keeps the old size, if a side is over max_resolution
+        bool resize(int newX, int newY);
+
+        //Functions to generate the mandelbrot:
+        //with show_passes, passFinished is called as each coarse preview pass is
+        //painted
+        void generate(bool show_passes = false);
+        //generates the frame of the given epoch. A thread started for a frame takes
+        //its epoch before starting, so a request made in between still cancels it
+        void generateFor(unsigned int frame, bool show_passes = false);
+        void resetMandelbrot();
+
+        //saves the image as a png (or a ppm, for any other extension)
+        bool saveImage(const std::string &filename);
+
+        //Converts a point from pixel coordinates to the corresponding
+        //coordinates of the complex plane
+        Point<DoubleDouble> pixelToComplex(double column, double row);
+
+    protected:
+        //called on the generating thread when a preview pass has been painted
+        virtual void passFinished() {}
+
+        //the stats of the last frame, guarded by mutex_image
+        RenderStats stats;
+
+        //counts the images published, to tell when there's a new one to show
+        std::atomic<unsigned int> image_version;
+        std::mutex mutex_image;        //guards front_pixels while they're swapped and read
+
+        int res_height;
+        int res_width;
+
+        //the colored images, 4 bytes per pixel. Coloring and the preview passes
+        //draw into pixels, the back image, and publishImage swaps it with the front
+        std::vector<unsigned char> pixels;
+        std::vector<unsigned char> front_pixels;
+        void publishImage();
+
+        //Parameters to generate the mandelbrot:
+        //generation epochs: every request for a new frame bumps epoch, and a
+        //generate only works for the epoch it started in. The workers check
+        //between squares, rows and passes, so a newer request stops the frame
+        //within a square of work. What it escaped so far is kept in sampled
+        std::atomic<unsigned int> epoch;
+        unsigned int frame_epoch;
+        bool cancelled() {return epoch.load(std::memory_order_relaxed) != frame_epoch;}
+
+        //this is the area of the complex plane to generate
+        Area area;
+        double area_inc; //this is complex plane area per pixel
+
+        //this is the center of the area at high precision. area follows it, but
+        //in double-double it can only be trusted down to a width of about 1e-28
+        HighPrecision center_x;
+        HighPrecision center_y;
+        Point<DoubleDouble> center_dd; //the center rounded to double-double
+
+        //the precision generation needs for the current view: doubles, double-doubles,
+        //or deep zoom. In deep zoom every pixel is iterated relative to a reference
+        //orbit. references[0] is at the center of the view and the rest are added
+        //during generation to fix glitches
+        enum PrecisionTier { TIER_DOUBLE, TIER_DOUBLE_DOUBLE, TIER_DEEP };
+        PrecisionTier tier;
+        //the most references deep zoom will calculate to fix glitches in one frame
+        static const unsigned int max_references = 64;
+        //the first reference_count slots are finished, and read without a lock.
+        //A slot is reserved under mutex_references, but its orbit is computed
+        //outside it, and threads that need the same slot wait on reference_ready
+        std::unique_ptr<ReferenceOrbit> references[max_references];
+        std::atomic<unsigned int> reference_count;
+        unsigned int references_reserved;
+        std::mutex mutex_references;
+        std::condition_variable reference_ready;
+
+        //the view the front image was generated for, guarded by mutex_image.
+        //The generating thread changes the tier, the references and max_iter,
+        //so anything describing the image on screen reads this instead
+        struct ViewInfo {
+            PrecisionTier tier;
+            unsigned int references;
+            unsigned int skip; //of references[0], in deep zoom
+            HighPrecision center_x, center_y;
+            Area area;
+            double area_inc;
+            unsigned int max_iter;
+            double rotation;
+        };
+        ViewInfo shown_view;
+        //the current view, for shown_view. Called on the generating thread, or
+        //when nothing is generating
+        ViewInfo currentView();
+
+        //this is the current rotation of the mandelbrot - 0 radians is positive x axis
+        double rotation;
+
+        //the map from pixels to the complex plane, kept up to date by updateBasis.
+        //Pixel (column, row) is at origin + column*step_column + row*step_row, and
+        //step_column and step_row are one pixel long, turned by the rotation. So
+        //rotating costs a couple of multiplies per pixel instead of trig
+        Point<DoubleDouble> basis_origin;
+        Point<double> step_column;
+        Point<double> step_row;
+
+        //print what each generate is doing
+        bool verbose;
+        bool kernel_reported; //the escape kernel is printed with the first verbose frame
+        
+        //this changes how the colors are displayed
+        double color_multiple;
+        bool color_locked;
+        int scheme;
+
+        //Holds the maximum number of concurrent threads suppported by the current CPU
+        unsigned int max_threads;
+
+        //the escape-time kernels to use, picked at startup for the widest SIMD unit
+        EscapeKernel escape_kernel;
+        DoubleDoubleKernel double_double_kernel;
+
+        //lets the double kernels stop early on points that are known to be in the
+        //set. The image is the same either way, it can be turned off to compare speed
+        bool interior_checks;
+
+        //this array stores the number of iterations for each pixel. It's kept
+        //compact (16 bit) whenever max_iter fits
+        IterationBuffer image_array;
+        //set when image_array holds a whole frame that was colored, so it can be
+        //colored again. A cancelled frame leaves it partly done
+        bool frame_complete;
+
+        //this array stores the last orbit value of every pixel that reached max_iter,
+        //so that increasing the iterations can continue from there instead of z = 0.
+        //orbits_valid is cleared whenever the view changes
+        //Like image_array it's one block, indexed by row * res_width + column
+        std::vector<Orbit> orbit_array;
+        bool orbits_valid;
+
+        //maximum number of iterations to check for. Higher values are slower,
+        //but more precise
+        std::atomic<unsigned int> max_iter;
+        std::atomic<unsigned int> last_max_iter;
+        // temp value for holding keys
+        std::atomic<unsigned int> temp_max_iter;
+
+
+        //Functions:
+        
+        //interpolate returns the increment to get from min to max in range iterations
+        double interpolate(double min, double max, int range) {return (max-min)/range;}
+        double interpolate(double length, int range) {return length/range;}
+
+        //escape calculates the escape-time of given point of the mandelbrot
+        int escape(int row, int column);
+
+        //escapeLine calculates the escape-time of count pixels, starting at (row, column)
+        //and stepping by (d_row, d_column), as one batch for the escape kernel
+        void escapeLine(int row, int column, int d_row, int d_column, int count, unsigned int *out);
+
+        //resizes orbit_array to the image and clears every saved orbit
+        void resetOrbits();
+
+        //moves the iterations, orbits and samples by a whole number of pixels, so
+        //that only the strips moving in from outside need to be escaped
+        void shiftSamples(int dx, int dy);
+        //does the same for a zoom by 2 or 4 (zoom_factor 0.25 to 4), where new pixel
+        //(column, row) is old pixel (ax + column*zoom_factor, ay + row*zoom_factor)
+        void scaleSamples(int ax, int ay, double zoom_factor);
+
+        //recalculates the area rectangle around the high precision center
+        void updateArea();
+        //recalculates the pixel basis from the area and the rotation
+        void updateBasis();
+
+        //rotates an offset from the center of the view by the current rotation
+        Point<double> rotateOffset(Point<double>);
+
+        //picks the precision tier for the view, and calculates the main reference
+        //if it needs deep zoom
+        void updatePrecisionTier();
+
+        //escapeDeep calculates the escape-time of points given as offsets from the
+        //center, using perturbation. Glitched points are redone with other references.
+        //Returns false if it gave up on them because the frame was cancelled
+        bool escapeDeep(const double *offset_x, const double *offset_y, unsigned int *iters,
+                        int count, unsigned int max);
+
+        //finishes the points in todo on the closest of the first count references,
+        //for when escapeDeep runs out of them
+        void escapeClosest(const std::vector<int> &todo, const double *offset_x,
+                           const double *offset_y, unsigned int *iters,
+                           unsigned int count, unsigned int max);
+
+        //returns reference i, or NULL if there isn't one yet
+        ReferenceOrbit *getReference(unsigned int i);
+
+        //makes reference i at the given offset, unless another thread already has.
+        //returns NULL if the frame has run out of references, or was cancelled
+        ReferenceOrbit *addReference(unsigned int i, double offset_x, double offset_y, unsigned int max);
+
+        //the scanline generator. genLine is a function for worker threads: it
+        //claims the next row from next_line, escapes all of it and writes it
+        //straight into image_array, until every row is done. Each row belongs to
+        //one thread, so nothing is locked
+        Generator generator;
+        std::atomic<int> next_line;
+        void genLine(int worker);
+
+        //progressive rendering: before the full image, coarse passes escape every 8th,
+        //4th and 2nd pixel and paint them as blocks. sampled marks the pixels already
+        //escaped this frame, so the later passes and the quadtree reuse them. Pixels
+        //the quadtree filled in aren't marked, so after a frame it marks the counts
+        //that are exact. Zooms and the tile cache only take those. A drag also keeps
+        //the quadtree's filled squares that stay on screen, marked as sample_filled
+        std::vector<unsigned char> sampled;
+        static const unsigned char sample_exact = 1;
+        static const unsigned char sample_filled = 2;
+        //set when a drag, or a frame that was cancelled, has filled sampled with
+        //the pixels it kept, so the next generate doesn't clear it
+        bool samples_seeded;
+        //the squares each quadtree worker filled in the last frame, moved along by drags
+        std::vector< std::vector<Square> > filled_squares;
+        std::atomic<int> next_pass_row;
+        //returns true if it published a pass
+        bool generatePreviews(bool show_passes);
+        void genPass(int step);  //worker thread function for one pass, like genLine
+        void paintPass(int step);
+
+        //tile progress: after the passes, each worker lists the regions it has
+        //finished (the quadtree's filled squares and the ones too small to split,
+        //or the scanline rows). Every preview_time worker 0 colors them over the
+        //last pass in the back image, and copies that to the front
+        bool tile_progress;
+        bool publishing_tiles; //set for the frames that do it
+        struct FinishedRegions {
+            std::mutex mutex;
+            std::vector<Square> squares;
+        };
+        std::vector< std::unique_ptr<FinishedRegions> > finished_regions;
+        std::vector<Square> regions_to_color;
+        std::chrono::steady_clock::time_point last_tile_publish;
+        void finishRegion(int worker, const Square &region);
+        void publishTiles();
+
+        //finished frames are cut into tiles on a grid of whole pixels, and kept in
+        //memory and on disk, so coming back to a view can skip escaping the pixels
+        //it already knows. Only exact counts (marked in sampled) go in a tile, the
+        //top bit of each count says whether it's there. Rotated views aren't cached
+        std::unique_ptr<TileCache> tile_cache;
+        bool use_tile_cache;
+        //the grid position of pixel (0, 0), and the key prefix that says which grid
+        //and max_iter the tiles belong to. Returns false if the view can't be cached
+        bool tileGrid(long long &grid_x, long long &grid_y, std::string &prefix);
+        std::string tileKey(const std::string &prefix, long long tile_x, long long tile_y);
+        void loadTiles();
+        void storeTiles();
+
+        //this looks up a color to print according to the escape value given
+        Color findColor(unsigned int iter);
+        void setPixel(int column, int row, Color color);
+
+        //whole images are colored from color_lut, findColor's color for every
+        //count from 0 to max_iter packed as RGBA. It's rebuilt when the palette,
+        //color_multiple or max_iter change. Past max_color_lut iterations the
+        //table would be too big, and colorImage uses findColor instead
+        ColorKernel color_kernel;
+        std::vector<uint32_t> color_lut;
+        bool color_lut_dirty;
+        double color_lut_multiple;
+        unsigned int color_lut_max_iter;
+        bool updateColorLut();
+        //colors rows first_row to first_row + rows - 1 from image_array
+        void colorRows(int first_row, int rows, bool use_lut);
+        //colors count pixels of a row, starting at column
+        void colorSpan(int row, int column, int count, bool use_lut);
+        //colors the whole back image, split over the thread pool
+        void colorImage();
+
+        //initialize the color palette. Having a palette helps avoid regenerating the
+        //color scheme each time it is needed
+        std::vector< std::vector<int> > palette;
+        void initPalette();
+        void smoosh(Color c1, Color c2, float min, float max);
+
+        //******************************************************************************
+        // Quadtree (Mariani-Silver) generator
+        //Every worker has its own deque of squares. It checks the squares it pops and
+        //either fills them or splits them, pushing the four quarters back on its own
+        //deque. Workers that run out steal from the others, and sleep when there is
+        //nothing left to steal
+        std::vector< std::unique_ptr<WorkStealingDeque> > quadtree_deques;
+        std::atomic< int > quadtree_pending;  // Squares pushed but not finished yet
+        std::atomic< int > quadtree_sleeping; // Workers waiting for squares
+        std::mutex mutex_quadtree_sleep;
+        std::condition_variable quadtree_wake;
+
+        void quadtree_createOutsideImage();    // Create the outside of the image to start the checks
+        // Escapes count pixels of an edge into the image, a chunk at a time. Returns false if cancelled
+        bool quadtree_escapeEdge(int row, int column, int d_row, int d_column, int count);
+
+        void quadtree_push(int worker, const Square &r_square); // Queue a square on a worker's deque
+        bool quadtree_steal(int worker, Square &r_square);      // Take a square from another worker
+        void quadtree_finish();                                 // Mark one pushed square as done
+        void quadtree_process(int worker, const Square &r_square); // Fill a square, or split it in four
+        bool quadtree_allEmpty();
+
+        void quadtree_master(bool show_passes);
+        void quadtree_worker(int worker);
+        // End Quadtree generator
+        //******************************************************************************
+
+        //counters for the frame being generated. escapeLine adds to the atomics
+        //once per call, and each quadtree worker has its own WorkerStats (padded
+        //so they don't share cache lines)
+        struct WorkerStats {
+            double busy, idle, compute, check, fill;
+            unsigned long long squares, splits, filled;
+            char padding[64];
+        };
+        std::atomic<unsigned long long> stat_escaped;
+        std::atomic<unsigned long long> stat_reused;
+        std::atomic<unsigned long long> stat_interior;
+        std::atomic<unsigned long long> stat_iterations;
+        std::vector<WorkerStats> worker_stats;
+        FILE *stats_log;
+        //collects the counters into stats at the end of a frame, and logs it
+        void finishStats(RenderStats &frame, bool finished);
+
+        //the threads generate() runs on. They live as long as the renderer, and are
+        //declared last so they stop before anything they use is destroyed
+        std::unique_ptr<ThreadPool> pool;
+        //returns the pool, making it first if max_threads has changed
+        ThreadPool &renderPool();
+};
+
+#endif
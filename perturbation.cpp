@@ -0,0 +1,165 @@
+#include "perturbation.h"
+#include <cmath>
+
+//how close z can get to zero, relative to the reference, before it is a glitch
+static const double glitch_tolerance = 1e-6;
+
+//how far the series approximation can be off from the probes, relative to dz
+static const double series_tolerance = 1e-8;
+
+//how many iterations of a reference orbit go by between asking whether to stop
+static const unsigned int stop_interval = 1024;
+
+bool computeReferenceOrbit(ReferenceOrbit &ref, const HighPrecision &cx, const HighPrecision &cy,
+                           unsigned int max_iter, const std::function<bool()> &stop) {
+    int words = cx.getPrecision();
+    HighPrecision x(words), y(words);
+    HighPrecision x_square(words), y_square(words);
+
+    ref.x.clear();
+    ref.y.clear();
+    ref.tolerance.clear();
+    ref.x.reserve(max_iter + 1);
+    ref.y.reserve(max_iter + 1);
+    ref.tolerance.reserve(max_iter + 1);
+    ref.x.push_back(0);
+    ref.y.push_back(0);
+    ref.tolerance.push_back(0);
+    ref.skip = 0;
+
+    //the same z = z^2 + c as the double kernels, just at high precision
+    for (unsigned int iter = 0; iter < max_iter; iter++) {
+        if (stop && iter % stop_interval == stop_interval - 1 && stop()) return false;
+
+        y = x * y;
+        y = y + y;
+        y += cy;
+        x = x_square - y_square + cx;
+
+        x_square = x * x;
+        y_square = y * y;
+
+        double zx = x.toDouble(), zy = y.toDouble();
+        double magnitude = zx*zx + zy*zy;
+        ref.x.push_back(zx);
+        ref.y.push_back(zy);
+        ref.tolerance.push_back(glitch_tolerance * magnitude);
+
+        if (magnitude > 4.0) break;
+    }
+    return true;
+}
+
+//The series approximation writes dz_n as a polynomial in dc. Putting it into the
+//perturbation formula gives the coefficients for the next iteration:
+//  A_n+1 = 2 Z_n A_n + 1
+//  B_n+1 = 2 Z_n B_n + A_n^2
+//  C_n+1 = 2 Z_n C_n + 2 A_n B_n
+void computeSeriesApproximation(ReferenceOrbit &ref, const double *probe_x, const double *probe_y,
+                                int probes, unsigned int max_iter) {
+    unsigned int length = ref.x.size() - 1;
+    double a_x = 0, a_y = 0, b_x = 0, b_y = 0, c_x = 0, c_y = 0;
+    std::vector<double> dx(probes, 0), dy(probes, 0);
+
+    ref.skip = 0;
+    ref.a_x = ref.a_y = ref.b_x = ref.b_y = ref.c_x = ref.c_y = 0;
+
+    for (unsigned int iter = 0; iter < max_iter && iter < length; iter++) {
+        double X = ref.x[iter], Y = ref.y[iter];
+
+        //next coefficients
+        double new_a_x = 2 * (X*a_x - Y*a_y) + 1;
+        double new_a_y = 2 * (X*a_y + Y*a_x);
+        double new_b_x = 2 * (X*b_x - Y*b_y) + a_x*a_x - a_y*a_y;
+        double new_b_y = 2 * (X*b_y + Y*b_x) + 2*a_x*a_y;
+        double new_c_x = 2 * (X*c_x - Y*c_y) + 2 * (a_x*b_x - a_y*b_y);
+        double new_c_y = 2 * (X*c_y + Y*c_x) + 2 * (a_x*b_y + a_y*b_x);
+        a_x = new_a_x; a_y = new_a_y;
+        b_x = new_b_x; b_y = new_b_y;
+        c_x = new_c_x; c_y = new_c_y;
+        if (!std::isfinite(a_x + a_y + b_x + b_y + c_x + c_y)) return;
+
+        //iterate the probes for real, and compare them with the series
+        for (int p=0; p<probes; p++) {
+            double new_dx = 2 * (X*dx[p] - Y*dy[p]) + dx[p]*dx[p] - dy[p]*dy[p] + probe_x[p];
+            dy[p] = 2 * (X*dy[p] + Y*dx[p]) + 2*dx[p]*dy[p] + probe_y[p];
+            dx[p] = new_dx;
+
+            double x = ref.x[iter+1] + dx[p];
+            double y = ref.y[iter+1] + dy[p];
+            double magnitude = x*x + y*y;
+            if (magnitude > 4.0 || magnitude < ref.tolerance[iter+1]) return;
+
+            //dc, dc^2 and dc^3
+            double d1x = probe_x[p], d1y = probe_y[p];
+            double d2x = d1x*d1x - d1y*d1y, d2y = 2*d1x*d1y;
+            double d3x = d2x*d1x - d2y*d1y, d3y = d2x*d1y + d2y*d1x;
+            double series_x = a_x*d1x - a_y*d1y + b_x*d2x - b_y*d2y + c_x*d3x - c_y*d3y;
+            double series_y = a_x*d1y + a_y*d1x + b_x*d2y + b_y*d2x + c_x*d3y + c_y*d3x;
+
+            double error = hypot(series_x - dx[p], series_y - dy[p]);
+            if (!(error <= series_tolerance * hypot(dx[p], dy[p]))) return;
+
+            //the last term has to stay small too, or the terms left out won't be
+            double last_term = hypot(c_x*d3x - c_y*d3y, c_x*d3y + c_y*d3x);
+            if (!(last_term <= series_tolerance * hypot(dx[p], dy[p]))) return;
+        }
+
+        //everything still matches, so every point can skip this iteration
+        ref.skip = iter + 1;
+        ref.a_x = a_x; ref.a_y = a_y;
+        ref.b_x = b_x; ref.b_y = b_y;
+        ref.c_x = c_x; ref.c_y = c_y;
+    }
+}
+
+//z_n = Z_n + dz_n, where Z is the reference. Then z = z^2 + c turns into
+//dz_n+1 = 2 Z_n dz_n + dz_n^2 + dc, which only involves small numbers
+void perturbationKernel(const ReferenceOrbit &ref, const double *dcx, const double *dcy,
+                        unsigned int *iters, char *glitched, int count, unsigned int max_iter) {
+    //the reference can only be followed as far as it goes
+    unsigned int length = ref.x.size() - 1;
+    const double *ref_x = ref.x.data();
+    const double *ref_y = ref.y.data();
+    const double *tolerance = ref.tolerance.data();
+
+    for (int i=0; i<count; i++) {
+        double dx = 0, dy = 0;
+        unsigned int iter = 0;
+        if (glitched) glitched[i] = 0;
+
+        //start from the series approximation if there is one
+        if (ref.skip > 0 && ref.skip <= max_iter) {
+            double d1x = dcx[i], d1y = dcy[i];
+            double d2x = d1x*d1x - d1y*d1y, d2y = 2*d1x*d1y;
+            double d3x = d2x*d1x - d2y*d1y, d3y = d2x*d1y + d2y*d1x;
+            dx = ref.a_x*d1x - ref.a_y*d1y + ref.b_x*d2x - ref.b_y*d2y + ref.c_x*d3x - ref.c_y*d3y;
+            dy = ref.a_x*d1y + ref.a_y*d1x + ref.b_x*d2y + ref.b_y*d2x + ref.c_x*d3y + ref.c_y*d3x;
+            iter = ref.skip;
+        }
+
+        for (; iter < max_iter; iter++) {
+            if (iter >= length) {
+                if (glitched) glitched[i] = 1;
+                break;
+            }
+            double X = ref_x[iter], Y = ref_y[iter];
+            double new_dx = 2 * (X*dx - Y*dy) + dx*dx - dy*dy + dcx[i];
+            dy = 2 * (X*dy + Y*dx) + 2*dx*dy + dcy[i];
+            dx = new_dx;
+
+            double x = ref_x[iter+1] + dx;
+            double y = ref_y[iter+1] + dy;
+            double magnitude = x*x + y*y;
+
+            //if the magnitude is greater than 2, it will escape
+            if (magnitude > 4.0) break;
+
+            if (glitched && magnitude < tolerance[iter+1]) {
+                glitched[i] = 1;
+                break;
+            }
+        }
+        iters[i] = iter;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include "highPrecision.h"
+#include <functional>
+#include <vector>
+
+//A reference orbit is one point iterated at high precision and stored as doubles.
+//Every other pixel is then iterated as a small difference from it (perturbation),
+//which a double can hold no matter how deep the zoom is.
+struct ReferenceOrbit {
+    //where the reference is, relative to the center of the view
+    double offset_x, offset_y;
+
+    //Z_n for every iteration, starting at Z_0 = 0, until it escapes or reaches max_iter
+    std::vector<double> x, y;
+
+    //when |z_n|^2 drops below tolerance[n] the difference from the reference has
+    //lost too much precision to trust (a glitch), and another reference is needed
+    std::vector<double> tolerance;
+
+    //series approximation: points start at iteration skip with dz = A dc + B dc^2 + C dc^3
+    //instead of at iteration 0. skip is 0 unless computeSeriesApproximation is called
+    unsigned int skip;
+    double a_x, a_y, b_x, b_y, c_x, c_y;
+};
+
+//iterates the reference at (cx, cy) and fills in ref. The offset is left alone.
+//A deep orbit can take seconds, so stop is asked every so often, and if it says
+//to stop this returns false with ref only partly done
+bool computeReferenceOrbit(ReferenceOrbit &ref, const HighPrecision &cx, const HighPrecision &cy,
+                           unsigned int max_iter,
+                           const std::function<bool()> &stop = std::function<bool()>());
+
+//works out how many iterations the points of a view can skip with the series
+//approximation, and the coefficients to do it. The probes are offsets (relative to
+//the reference) on the edge of the view; they are iterated alongside the series,
+//and it stops as soon as the series stops matching them, or one escapes or glitches
+void computeSeriesApproximation(ReferenceOrbit &ref, const double *probe_x, const double *probe_y,
+                                int probes, unsigned int max_iter);
+
+//perturbationKernel is the deep zoom version of the escape kernel. The points are
+//given as (dcx, dcy) relative to the reference. Points that glitch have glitched[i]
+//set and have to be done again with a different reference. With glitched NULL the
+//glitches are ignored, for when there are no references left to try
+void perturbationKernel(const ReferenceOrbit &ref, const double *dcx, const double *dcy,
+                        unsigned int *iters, char *glitched, int count, unsigned int max_iter);
+
+#endif
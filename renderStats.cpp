@@ -0,0 +1,83 @@
+#include "renderStats.h"
+#include <sstream>
+#include <iomanip>
+
+RenderStats::RenderStats() {
+    width = 0;
+    height = 0;
+    max_iter = 0;
+    tier = "double";
+    generator = "quadtree";
+    finished = false;
+    total_seconds = 0;
+    cache_seconds = 0;
+    preview_seconds = 0;
+    border_seconds = 0;
+    compute_seconds = 0;
+    check_seconds = 0;
+    fill_seconds = 0;
+    color_seconds = 0;
+    escaped = 0;
+    reused = 0;
+    filled = 0;
+    interior = 0;
+    iterations = 0;
+    squares = 0;
+    splits = 0;
+}
+
+static void jsonList(std::ostream &out, const std::vector<double> &list) {
+    out << "[";
+    for (unsigned int i=0; i<list.size(); i++) {
+        out << (i ? ", " : "") << list[i];
+    }
+    out << "]";
+}
+
+std::string RenderStats::toJson() const {
+    std::stringstream ss;
+    ss << std::setprecision(6);
+    ss << "{\"width\": " << width << ", \"height\": " << height << ", \"max_iter\": " << max_iter
+       << ", \"tier\": \"" << tier << "\", \"generator\": \"" << generator << "\", \"finished\": " << (finished ? "true" : "false")
+       << ", \"total_seconds\": " << total_seconds << ", \"cache_seconds\": " << cache_seconds
+       << ", \"preview_seconds\": " << preview_seconds << ", \"border_seconds\": " << border_seconds
+       << ", \"compute_seconds\": " << compute_seconds << ", \"check_seconds\": " << check_seconds
+       << ", \"fill_seconds\": " << fill_seconds << ", \"color_seconds\": " << color_seconds
+       << ", \"escaped\": " << escaped << ", \"reused\": " << reused << ", \"filled\": " << filled
+       << ", \"interior\": " << interior << ", \"iterations\": " << iterations
+       << ", \"squares\": " << squares << ", \"splits\": " << splits << ", \"busy_seconds\": ";
+    jsonList(ss, busy_seconds);
+    ss << ", \"idle_seconds\": ";
+    jsonList(ss, idle_seconds);
+    ss << "}";
+    return ss.str();
+}
+
+std::string RenderStats::toText() const {
+    double busy = 0, idle = 0;
+    for (unsigned int i=0; i<busy_seconds.size(); i++) {
+        busy += busy_seconds[i];
+        idle += idle_seconds[i];
+    }
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << "Last frame " << std::setw(9) << total_seconds * 1000 << " ms" << (finished ? "" : " (restarted)") << "\n";
+    ss << "  " << generator << ", " << tier << "\n";
+    ss << "  cache    " << std::setw(9) << cache_seconds * 1000 << " ms\n";
+    ss << "  previews " << std::setw(9) << preview_seconds * 1000 << " ms\n";
+    ss << "  border   " << std::setw(9) << border_seconds * 1000 << " ms\n";
+    ss << "  compute  " << std::setw(9) << compute_seconds * 1000 << " ms\n";
+    ss << "  checks   " << std::setw(9) << check_seconds * 1000 << " ms\n";
+    ss << "  fills    " << std::setw(9) << fill_seconds * 1000 << " ms\n";
+    ss << "  color    " << std::setw(9) << color_seconds * 1000 << " ms\n";
+    ss << "Escaped    " << std::setw(9) << escaped << " px\n";
+    ss << "Filled     " << std::setw(9) << filled << " px\n";
+    ss << "Reused     " << std::setw(9) << reused << " px\n";
+    ss << "Interior   " << std::setw(9) << interior << " px\n";
+    ss << "Iterations " << std::setw(9) << iterations / 1e6 << " M\n";
+    ss << "Squares    " << std::setw(9) << squares << " (" << splits << " split)\n";
+    ss << std::setprecision(0) << "Threads " << busy_seconds.size() << ", "
+       << (busy + idle > 0 ? 100 * busy / (busy + idle) : 0) << "% busy";
+    return ss.str();
+}
@@ -0,0 +1,48 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <string>
+#include <vector>
+
+//RenderStats is where one generate spent its time and how much work it did.
+//The times of the quadtree (compute, check and fill) are added up over all of
+//the worker threads, the others are wall time on the generating thread
+struct RenderStats {
+    RenderStats();
+
+    int width;
+    int height;
+    unsigned int max_iter;
+    const char *tier;       //"double", "double-double" or "deep"
+    const char *generator;  //"quadtree" or "scanline"
+    bool finished;          //false if the frame was restarted before it was done
+
+    double total_seconds;
+    double cache_seconds;   //loading and storing tiles
+    double preview_seconds; //the coarse passes, painting included
+    double border_seconds;  //escaping the outer edge of the image
+    double compute_seconds; //escaping the quadtree's split lines, or the scanline rows
+    double check_seconds;   //checking whether a square's border is all one count
+    double fill_seconds;    //filling the squares that were
+    double color_seconds;   //coloring the finished image
+
+    unsigned long long escaped;    //pixels run through an escape kernel
+    unsigned long long reused;     //pixels that kept a count from before instead
+    unsigned long long filled;     //pixels the quadtree filled without escaping them
+    unsigned long long interior;   //escaped pixels the interior checks stopped early
+    unsigned long long iterations; //iterations the kernels ran, not counting interior pixels
+    unsigned long long squares;    //squares the quadtree checked
+    unsigned long long splits;     //squares it had to split
+
+    //how long each quadtree worker spent on squares, and waiting for or
+    //looking for one
+    std::vector<double> busy_seconds;
+    std::vector<double> idle_seconds;
+
+    //one line of JSON
+    std::string toJson() const;
+    //a few lines to read, for the overlay
+    std::string toText() const;
+};
+
+#endif
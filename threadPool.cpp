@@ -0,0 +1,48 @@
+#include "threadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    stopping = false;
+    if (threads == 0) threads = 1;
+    for (unsigned int i=0; i<threads; i++) {
+        workers.push_back(std::thread(&ThreadPool::run, this));
+    }
+}
+
+//unstarted jobs are dropped, running ones are waited for
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_jobs);
+        stopping = true;
+        jobs.clear();
+    }
+    job_ready.notify_all();
+    for (unsigned int i=0; i<workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job) {
+    std::packaged_task<void()> task(job);
+    std::future<void> done = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_jobs);
+        jobs.push_back(std::move(task));
+    }
+    job_ready.notify_one();
+    return done;
+}
+
+//this is what every worker thread runs: take the next job, run it, repeat
+void ThreadPool::run() {
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_jobs);
+            while (!stopping && jobs.empty()) job_ready.wait(lock);
+            if (stopping) return;
+            task = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        task();
+    }
+}
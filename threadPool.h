@@ -0,0 +1,35 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+
+//ThreadPool keeps a fixed set of worker threads alive for the life of the viewer,
+//so a generate doesn't pay for starting and joining threads. Jobs are run in the
+//order they are submitted, and each one gets a future that is ready when it's done.
+//Jobs that should stop early have to check their own stop flag.
+class ThreadPool {
+    public:
+        ThreadPool(unsigned int threads);
+        ~ThreadPool();
+
+        unsigned int size() const {return workers.size();}
+
+        std::future<void> submit(std::function<void()> job);
+
+    private:
+        std::vector<std::thread> workers;
+        std::deque< std::packaged_task<void()> > jobs;
+        std::mutex mutex_jobs;
+        std::condition_variable job_ready;
+        bool stopping;
+
+        void run();
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "tileCache.h"
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//every file starts with this, then the length of the key, the key, and the counts
+static const char tile_magic[4] = {'M', 'B', 'T', '1'};
+static const size_t tile_bytes = TileCache::tile_size * TileCache::tile_size * sizeof(uint32_t);
+//how many tiles can wait for the writer thread (16KB each)
+static const unsigned int max_writes = 1024;
+
+TileCache::TileCache(const std::string &directory, unsigned int memory_tiles, unsigned int disk_tiles) {
+    this->directory = directory;
+    this->memory_tiles = memory_tiles > 0 ? memory_tiles : 1;
+    this->disk_tiles = disk_tiles > 0 ? disk_tiles : 1;
+    directory_ready = false;
+    files_listed = false;
+    stopping = false;
+    hits = 0;
+    misses = 0;
+}
+
+TileCache::~TileCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_writes);
+        stopping = true;
+    }
+    write_ready.notify_all();
+    if (writer.joinable()) writer.join();
+}
+
+bool TileCache::load(const std::string &key, uint32_t *counts) {
+    std::unordered_map<std::string, TileList::iterator>::iterator found = index.find(key);
+    if (found != index.end()) {
+        //move it to the front, it's the most recently used now
+        tiles.splice(tiles.begin(), tiles, found->second);
+        memcpy(counts, found->second->second.data(), tile_bytes);
+        hits++;
+        return true;
+    }
+    if (readFile(key, counts)) {
+        remember(key, counts);
+        hits++;
+        return true;
+    }
+    misses++;
+    return false;
+}
+
+void TileCache::store(const std::string &key, const uint32_t *counts) {
+    remember(key, counts);
+    if (directory.empty()) return;
+    if (!directory_ready) {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            //can't write anywhere, keep going with just the memory cache
+            directory.clear();
+            return;
+        }
+        directory_ready = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_writes);
+    if (!writer.joinable()) writer = std::thread(&TileCache::writeFiles, this);
+    if (writes.size() >= max_writes) writes.pop_front();
+    writes.push_back(std::make_pair(key, std::vector<uint32_t>(counts, counts + tile_size * tile_size)));
+    write_ready.notify_one();
+}
+
+//the writer thread, it runs until the cache is destroyed and nothing is left to write
+void TileCache::writeFiles() {
+    std::unique_lock<std::mutex> lock(mutex_writes);
+    while (true) {
+        while (!stopping && writes.empty()) write_ready.wait(lock);
+        if (writes.empty()) return;
+        std::pair< std::string, std::vector<uint32_t> > tile;
+        tile.swap(writes.front());
+        writes.pop_front();
+        lock.unlock();
+        writeFile(tile.first, tile.second.data());
+        lock.lock();
+    }
+}
+
+void TileCache::remember(const std::string &key, const uint32_t *counts) {
+    std::unordered_map<std::string, TileList::iterator>::iterator found = index.find(key);
+    if (found != index.end()) {
+        tiles.splice(tiles.begin(), tiles, found->second);
+    } else {
+        //reuse the least recently used tile's memory when full
+        if (tiles.size() >= memory_tiles) {
+            index.erase(tiles.back().first);
+            tiles.splice(tiles.begin(), tiles, --tiles.end());
+            tiles.front().first = key;
+        } else {
+            tiles.push_front(std::make_pair(key, std::vector<uint32_t>(tile_size * tile_size)));
+        }
+        index[key] = tiles.begin();
+    }
+    memcpy(tiles.front().second.data(), counts, tile_bytes);
+}
+
+//the file is named after a 64 bit FNV-1a hash of the key. The key is stored in
+//the file too, so a collision just looks like a miss
+std::string TileCache::fileName(const std::string &key) const {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned int i=0; i<key.size(); i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.tile", (unsigned long long) hash);
+    return directory + name;
+}
+
+bool TileCache::readFile(const std::string &key, uint32_t *counts) {
+    if (directory.empty()) return false;
+    std::string name = fileName(key);
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    size_t header = sizeof(tile_magic) + sizeof(uint32_t) + key.size();
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size != header + tile_bytes) {
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    const char *bytes = (const char *) mapped;
+    uint32_t key_length;
+    memcpy(&key_length, bytes + sizeof(tile_magic), sizeof(key_length));
+    bool matches = memcmp(bytes, tile_magic, sizeof(tile_magic)) == 0 &&
+                   key_length == key.size() &&
+                   memcmp(bytes + sizeof(tile_magic) + sizeof(key_length), key.data(), key.size()) == 0;
+    if (matches) {
+        memcpy(counts, bytes + header, tile_bytes);
+        //the modification time is when it was last used, for the next run's trimming
+        futimens(fd, NULL);
+    }
+    munmap(mapped, info.st_size);
+    close(fd);
+    if (matches) usedFile(name);
+    return matches;
+}
+
+//runs on the writer thread
+void TileCache::writeFile(const std::string &key, const uint32_t *counts) {
+    //write to a temporary file and rename it over, so a reader never sees half a tile
+    std::string name = fileName(key);
+    std::string temporary = name + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == NULL) return;
+    uint32_t key_length = key.size();
+    bool written = fwrite(tile_magic, sizeof(tile_magic), 1, file) == 1 &&
+                   fwrite(&key_length, sizeof(key_length), 1, file) == 1 &&
+                   fwrite(key.data(), 1, key.size(), file) == key.size() &&
+                   fwrite(counts, tile_bytes, 1, file) == 1;
+    if (fclose(file) != 0) written = false;
+    if (!written || rename(temporary.c_str(), name.c_str()) != 0) {
+        remove(temporary.c_str());
+        return;
+    }
+    usedFile(name);
+}
+
+//finds the tiles already in the directory, newest first
+void TileCache::listFiles() {
+    files_listed = true;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL) return;
+    std::vector< std::pair<double, std::string> > found;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string name = entry->d_name;
+        if (name.size() < 5 || name.compare(name.size() - 5, 5, ".tile") != 0) continue;
+        name = directory + "/" + name;
+        struct stat info;
+        if (stat(name.c_str(), &info) != 0) continue;
+        double modified = info.st_mtim.tv_sec + info.st_mtim.tv_nsec * 1e-9;
+        found.push_back(std::make_pair(modified, name));
+    }
+    closedir(dir);
+
+    std::sort(found.begin(), found.end());
+    for (unsigned int i=0; i<found.size(); i++) {
+        files.push_front(found[i].second);
+        file_index[found[i].second] = files.begin();
+    }
+}
+
+//moves the file to the front of the list, and removes the least recently used
+//files while there are too many
+void TileCache::usedFile(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex_files);
+    if (!files_listed) listFiles();
+    std::unordered_map<std::string, std::list<std::string>::iterator>::iterator found = file_index.find(name);
+    if (found != file_index.end()) {
+        files.splice(files.begin(), files, found->second);
+    } else {
+        files.push_front(name);
+        file_index[name] = files.begin();
+    }
+    while (files.size() > disk_tiles) {
+        remove(files.back().c_str());
+        file_index.erase(files.back());
+        files.pop_back();
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <string>
+#include <list>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+//TileCache keeps square tiles of escape-times so that a view that was already
+//rendered doesn't have to be computed again. The most recently used tiles are
+//kept in memory, and every tile is also written to its own file in a directory
+//so they survive between runs. Files are read back by memory-mapping them, and
+//written by a thread of their own so storing doesn't hold up the caller. The
+//directory is trimmed to the disk_tiles most recently used files.
+//
+//A tile is tile_size x tile_size counts, row after row. The cache doesn't know
+//what the counts mean, the caller packs whatever it wants into them, and the key
+//has to say everything the counts depend on (position, pixel size, max_iter).
+class TileCache {
+    public:
+        static const int tile_size = 64;
+
+        //memory_tiles is how many tiles are kept in memory, and disk_tiles how many
+        //files are kept in the directory. An empty directory keeps everything in
+        //memory only
+        TileCache(const std::string &directory, unsigned int memory_tiles, unsigned int disk_tiles);
+        //waits for the files still waiting to be written
+        ~TileCache();
+
+        //copies the tile into counts and returns true, or returns false if it
+        //isn't in the cache
+        bool load(const std::string &key, uint32_t *counts);
+        //adds the tile, replacing any older one with the same key
+        void store(const std::string &key, const uint32_t *counts);
+
+        unsigned int getHits() const {return hits;}
+        unsigned int getMisses() const {return misses;}
+
+    private:
+        typedef std::list< std::pair< std::string, std::vector<uint32_t> > > TileList;
+
+        std::string directory;
+        bool directory_ready;
+        unsigned int memory_tiles;
+        unsigned int disk_tiles;
+
+        //most recently used at the front
+        TileList tiles;
+        std::unordered_map<std::string, TileList::iterator> index;
+
+        unsigned int hits;
+        unsigned int misses;
+
+        //the files in the directory, most recently used at the front. Read in
+        //by modification time the first time the directory is used
+        std::list<std::string> files;
+        std::unordered_map<std::string, std::list<std::string>::iterator> file_index;
+        bool files_listed;
+        std::mutex mutex_files;
+
+        //tiles waiting for the writer thread. If it falls too far behind the
+        //oldest ones are dropped, they're still in memory
+        TileList writes;
+        std::thread writer;
+        std::mutex mutex_writes;
+        std::condition_variable write_ready;
+        bool stopping;
+
+        void remember(const std::string &key, const uint32_t *counts);
+        std::string fileName(const std::string &key) const;
+        bool readFile(const std::string &key, uint32_t *counts);
+        void writeFile(const std::string &key, const uint32_t *counts);
+        void writeFiles();
+        void listFiles();
+        void usedFile(const std::string &name);
+};
+
+#endif
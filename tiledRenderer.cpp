@@ -0,0 +1,114 @@
+#include "tiledRenderer.h"
+#include "mandelbrotRenderer.h"
+#include "imageWriter.h"
+#include <vector>
+#include <future>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string.h>
+#include <math.h>
+
+TiledRenderer::TiledRenderer(int width, int height, int tile_width, int tile_height) {
+    this->width = width;
+    this->height = height;
+    this->tile_width = std::min(tile_width, width);
+    this->tile_height = std::min(tile_height, height);
+
+    //the explorer's starting view
+    setView(HighPrecision(-0.5, 2), HighPrecision(0.0, 2), 2.0 * width / height);
+    iterations = 1000;
+    scheme = 1;
+    color_multiple = 1;
+    rotation = 0;
+    threads = 0;
+}
+
+void TiledRenderer::setView(const HighPrecision &x, const HighPrecision &y, double view_width) {
+    pixel_size = view_width / width;
+    int words = HighPrecision::wordsFor(pixel_size);
+    center_x = x;
+    center_y = y;
+    center_x.setPrecision(words);
+    center_y.setPrecision(words);
+}
+
+size_t TiledRenderer::memoryNeeded() const {
+    //two bands of RGBA, and the renderer's counts, orbits, samples and RGBA
+    size_t bands = 2 * (size_t) width * tile_height * 4;
+    size_t tile = (size_t) tile_width * tile_height * (4 + sizeof(Orbit) + 1 + 4);
+    return bands + tile;
+}
+
+bool TiledRenderer::render(const std::string &filename) {
+    ImageWriter writer;
+    if (!writer.open(filename, width, height)) return false;
+
+    //every tile is a whole tile_width x tile_height render, the ones hanging off
+    //the right and bottom edges are cropped
+    MandelbrotRenderer renderer(tile_width, tile_height);
+    if (threads > 0) renderer.setThreads(threads);
+    renderer.enableTileCache(false);
+    renderer.setVerbose(false);
+    renderer.setColorScheme(scheme);
+    renderer.setColorMultiple(color_multiple);
+    renderer.setIterations(iterations);
+    renderer.setRotation(rotation);
+    int words = HighPrecision::wordsFor(pixel_size);
+
+    //one band is written while the next is rendered
+    std::vector<unsigned char> bands[2];
+    bands[0].resize((size_t) width * tile_height * 4);
+    bands[1].resize((size_t) width * tile_height * 4);
+    std::future<bool> writing;
+    bool written = true;
+
+    int band_count = (height + tile_height - 1) / tile_height;
+    int columns = (width + tile_width - 1) / tile_width;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int band = 0; band < band_count; band++) {
+        std::vector<unsigned char> &pixels = bands[band % 2];
+        int top = band * tile_height;
+        int rows = std::min(tile_height, height - top);
+
+        for (int column = 0; column < columns; column++) {
+            int left = column * tile_width;
+            int count = std::min(tile_width, width - left);
+
+            //the tile's center, as an offset from the image's center. Rotating the
+            //offset puts the tile where it belongs in the rotated image, and then
+            //the renderer rotates the tile around its own center
+            double offset_x = (left + tile_width/2.0 - width/2.0) * pixel_size;
+            double offset_y = (top + tile_height/2.0 - height/2.0) * pixel_size;
+            double rotated_x = offset_x * cos(rotation) - offset_y * sin(rotation);
+            double rotated_y = offset_x * sin(rotation) + offset_y * cos(rotation);
+            renderer.setView(center_x + HighPrecision(rotated_x, words),
+                             center_y + HighPrecision(rotated_y, words),
+                             pixel_size * tile_width);
+            renderer.generate();
+
+            const unsigned char *tile = renderer.getPixels();
+            for (int i=0; i<rows; i++) {
+                memcpy(&pixels[((size_t) i * width + left) * 4],
+                       tile + (size_t) i * tile_width * 4, (size_t) count * 4);
+            }
+        }
+
+        //wait for the last band to be written before handing over this one
+        if (writing.valid()) written = writing.get() && written;
+        writing = std::async(std::launch::async, &ImageWriter::writeRows, &writer,
+                             pixels.data(), rows);
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double done = (double) (top + rows) * width;
+        double total = (double) height * width;
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Band " << band + 1 << "/" << band_count << " (" << 100 * done / total << "%), "
+                  << done / elapsed / 1e6 << " Mpixels/s, "
+                  << elapsed * (total - done) / done << "s left" << std::endl;
+    }
+    if (writing.valid()) written = writing.get() && written;
+
+    return writer.close() && written;
+}
@@ -0,0 +1,49 @@
+#ifndef TILEDRENDERER_H
+#define TILEDRENDERER_H
+
+#include <string>
+#include "highPrecision.h"
+
+//TiledRenderer makes images far too big to hold in memory. The image is cut
+//into tiles that are rendered one after another by one tile-sized
+//MandelbrotRenderer (which uses all the cores on each tile). A row of tiles
+//makes a band, and each band is streamed to the file by ImageWriter while the
+//next one renders. Memory use is two bands plus one tile, whatever the size of
+//the image.
+class TiledRenderer {
+    public:
+        TiledRenderer(int width, int height, int tile_width, int tile_height);
+
+        //the same settings as MandelbrotRenderer. view_width is the width of
+        //the whole image on the complex plane
+        void setView(const HighPrecision &x, const HighPrecision &y, double view_width);
+        void setIterations(int iter) {iterations = iter;}
+        void setColorScheme(int newScheme) {scheme = newScheme;}
+        void setColorMultiple(double mult) {color_multiple = mult;}
+        void setRotation(double radians) {rotation = radians;}
+        void setThreads(unsigned int count) {threads = count;}
+
+        //bytes of memory the bands and the tile renderer need
+        size_t memoryNeeded() const;
+
+        //renders the image to filename (any format ImageWriter knows), printing
+        //progress after every band. Returns false if the file couldn't be written
+        bool render(const std::string &filename);
+
+    private:
+        int width;
+        int height;
+        int tile_width;
+        int tile_height;
+
+        HighPrecision center_x;
+        HighPrecision center_y;
+        double pixel_size;
+        int iterations;
+        int scheme;
+        double color_multiple;
+        double rotation;
+        unsigned int threads;
+};
+
+#endif
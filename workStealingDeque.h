@@ -0,0 +1,85 @@
+#ifndef WORKSTEALINGDEQUE_H
+#define WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+//WorkStealingDeque is a lock-free Chase-Lev deque of 64 bit tasks. The worker
+//that owns it pushes and pops at the bottom, any other worker can steal from the
+//top. It has a fixed capacity; push returns false when it's full, and the owner
+//should just run the task itself.
+//
+//This follows "Correct and Efficient Work-Stealing for Weak Memory Models"
+//(Le, Pop, Cohen and Zappa Nardelli, 2013)
+class WorkStealingDeque {
+    public:
+        static const int64_t capacity = 1024;
+
+        WorkStealingDeque() : top(0), bottom(0) {
+            for (int64_t i=0; i<capacity; i++) tasks[i].store(0, std::memory_order_relaxed);
+        }
+
+        //only the owner can call this
+        void clear() {
+            top.store(0, std::memory_order_relaxed);
+            bottom.store(0, std::memory_order_relaxed);
+        }
+
+        //only the owner can push and pop
+        bool push(uint64_t task) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= capacity) return false;
+            tasks[b % capacity].store(task, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+        bool pop(uint64_t &task) {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                //empty
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+            task = tasks[b % capacity].load(std::memory_order_relaxed);
+            if (t == b) {
+                //the last task, race the thieves for it
+                bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                       std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        //any thread can steal. This can fail when racing another thread for the
+        //same task even though the deque isn't empty
+        bool steal(uint64_t &task) {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) return false;
+            task = tasks[t % capacity].load(std::memory_order_relaxed);
+            return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                               std::memory_order_relaxed);
+        }
+
+        //a guess, since other threads can change it at any time
+        bool looksEmpty() const {
+            return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+        }
+
+    private:
+        //top and bottom are padded onto their own cache lines, the thieves hammer top
+        std::atomic<int64_t> top;
+        char pad_top[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<int64_t> bottom;
+        char pad_bottom[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<uint64_t> tasks[capacity];
+};
+
+#endif
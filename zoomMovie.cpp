@@ -0,0 +1,244 @@
+#include "zoomMovie.h"
+#include "mandelbrotRenderer.h"
+#include "imageWriter.h"
+#include "threadPool.h"
+#include <future>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <math.h>
+
+ZoomMovie::ZoomMovie(int width, int height, int frames) {
+    this->width = width;
+    this->height = height;
+    this->frames = frames;
+
+    //the explorer's starting view, zooming in 2^10
+    setView(HighPrecision(-0.5, 2), HighPrecision(0.0, 2), 4.0, 4.0 / 1024);
+    iterations = 1000;
+    scheme = 1;
+    color_multiple = 1;
+    rotation = 0;
+    threads = 0;
+    key_scale = 1.5;
+}
+
+void ZoomMovie::setView(const HighPrecision &x, const HighPrecision &y, double start_width, double end_width) {
+    this->start_width = std::max(start_width, end_width);
+    this->end_width = end_width;
+    int words = HighPrecision::wordsFor(end_width / width);
+    center_x = x;
+    center_y = y;
+    center_x.setPrecision(words);
+    center_y.setPrecision(words);
+}
+
+//keyframes are end_width * 2^k, for k from 0 until they cover start_width
+int ZoomMovie::getKeyframes() const {
+    return (int) ceil(log2(start_width / end_width) - 1e-9) + 1;
+}
+
+//keyframes are a multiple of 4 pixels on each side, so zooming in by 2 keeps
+//the center exactly on the center, and the renderer can reuse a quarter of
+//the last keyframe's pixels. They are at least as tall as the frames
+int ZoomMovie::getKeyframeWidth() const {
+    return (int) ceil(width * std::max(key_scale, 1.0) / 4) * 4;
+}
+
+int ZoomMovie::getKeyframeHeight() const {
+    return (int) ceil((double) getKeyframeWidth() * height / width / 4) * 4;
+}
+
+bool ZoomMovie::isFramePattern(const std::string &pattern) {
+    int conversions = 0;
+    for (size_t i=0; i<pattern.size(); i++) {
+        if (pattern[i] != '%') continue;
+        //a width, with or without a leading 0, then the d
+        size_t j = i + 1;
+        while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') j++;
+        if (j >= pattern.size() || pattern[j] != 'd' || j - i > 4) return false;
+        conversions++;
+        i = j;
+    }
+    return conversions == 1;
+}
+
+bool ZoomMovie::renderFrames(const std::string &pattern) {
+    return render(pattern, NULL);
+}
+
+bool ZoomMovie::renderVideo(FILE *out) {
+    return render("", out);
+}
+
+//reads the RGB of a keyframe at (x, y) in its pixel coordinates, blending the
+//four pixels around it. Points outside the keyframe get its edge
+static inline void bilinear(const unsigned char *key, int key_width, int key_height,
+                            double x, double y, float *rgb) {
+    x = std::min(std::max(x, 0.0), key_width - 1.0);
+    y = std::min(std::max(y, 0.0), key_height - 1.0);
+    int x0 = std::min((int) x, key_width - 2);
+    int y0 = std::min((int) y, key_height - 2);
+    float fx = x - x0, fy = y - y0;
+    const unsigned char *p = key + ((size_t) y0 * key_width + x0) * 4;
+    const unsigned char *q = p + (size_t) key_width * 4;
+    for (int c=0; c<3; c++) {
+        float top = p[c] + (p[c + 4] - p[c]) * fx;
+        float bottom = q[c] + (q[c + 4] - q[c]) * fx;
+        rgb[c] += top + (bottom - top) * fy;
+    }
+}
+
+//averages a footprint by footprint square of keyframe pixels centered on (x, y),
+//so that shrinking a keyframe doesn't alias
+static inline void boxSample(const unsigned char *key, int key_width, int key_height,
+                             double x, double y, double footprint, float *rgb) {
+    int n = std::max(1, (int) ceil(footprint - 1e-6));
+    double step = footprint / n;
+    double start = (step - footprint) / 2;
+    float sum[3] = {0, 0, 0};
+    for (int a=0; a<n; a++) {
+        for (int b=0; b<n; b++) {
+            bilinear(key, key_width, key_height, x + start + b*step, y + start + a*step, sum);
+        }
+    }
+    for (int c=0; c<3; c++) rgb[c] = sum[c] / (n*n);
+}
+
+void ZoomMovie::resample(std::vector<unsigned char> &frame, double frame_width,
+                         const std::vector<unsigned char> &inner, const std::vector<unsigned char> &outer,
+                         double key_width, int key_res_width, int key_res_height, int first_row, int rows) {
+    //one frame pixel is footprint inner keyframe pixels wide, and half that many
+    //outer ones. Pixel j is (j - width/2) pixels from the center in both
+    double footprint = (frame_width / width) / (key_width / key_res_width);
+    //the inner keyframe fades into the outer one over its last two frame pixels
+    double blend = std::max(2 * footprint, 1.0);
+
+    for (int i=first_row; i<first_row + rows; i++) {
+        unsigned char *out = &frame[(size_t) i * width * 4];
+        double y = (i - height/2.0) * footprint;
+        for (int j=0; j<width; j++) {
+            double x = (j - width/2.0) * footprint;
+            double inner_x = x + key_res_width/2.0;
+            double inner_y = y + key_res_height/2.0;
+            double margin = std::min(std::min(inner_x, key_res_width - 1 - inner_x),
+                                     std::min(inner_y, key_res_height - 1 - inner_y));
+            double weight = outer.empty() ? 1 : std::min(std::max(margin / blend, 0.0), 1.0);
+
+            float rgb[3] = {0, 0, 0};
+            if (weight > 0) {
+                boxSample(inner.data(), key_res_width, key_res_height, inner_x, inner_y, footprint, rgb);
+            }
+            if (weight < 1) {
+                float outside[3];
+                boxSample(outer.data(), key_res_width, key_res_height, x/2 + key_res_width/2.0,
+                          y/2 + key_res_height/2.0, footprint/2, outside);
+                for (int c=0; c<3; c++) rgb[c] = rgb[c] * weight + outside[c] * (1 - weight);
+            }
+            out[j*4] = (unsigned char) (rgb[0] + 0.5f);
+            out[j*4 + 1] = (unsigned char) (rgb[1] + 0.5f);
+            out[j*4 + 2] = (unsigned char) (rgb[2] + 0.5f);
+            out[j*4 + 3] = 255;
+        }
+    }
+}
+
+//writes one frame, to its own file or as RGB rows on out
+static bool writeFrame(const std::string &pattern, FILE *out, int number,
+                       const std::vector<unsigned char> &rgba, int width, int height) {
+    if (out == NULL) {
+        char name[4096];
+        snprintf(name, sizeof(name), pattern.c_str(), number);
+        return writeImage(name, rgba.data(), width, height);
+    }
+    std::vector<unsigned char> row((size_t) width * 3);
+    for (int i=0; i<height; i++) {
+        const unsigned char *in = &rgba[(size_t) i * width * 4];
+        for (int j=0; j<width; j++) {
+            row[j*3] = in[j*4];
+            row[j*3 + 1] = in[j*4 + 1];
+            row[j*3 + 2] = in[j*4 + 2];
+        }
+        if (fwrite(row.data(), 1, row.size(), out) != row.size()) return false;
+    }
+    return fflush(out) == 0;
+}
+
+bool ZoomMovie::render(const std::string &pattern, FILE *out) {
+    int key_res_width = getKeyframeWidth();
+    int key_res_height = getKeyframeHeight();
+    if (key_res_width > MandelbrotRenderer::max_resolution ||
+        key_res_height > MandelbrotRenderer::max_resolution) return false;
+    if (out == NULL && !isFramePattern(pattern)) return false;
+    int keyframes = getKeyframes();
+
+    MandelbrotRenderer renderer(key_res_width, key_res_height);
+    if (threads > 0) renderer.setThreads(threads);
+    renderer.enableTileCache(false);
+    renderer.setVerbose(false);
+    renderer.setColorScheme(scheme);
+    renderer.setColorMultiple(color_multiple);
+    renderer.setIterations(iterations);
+    renderer.setRotation(rotation);
+
+    ThreadPool pool(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency()));
+    int jobs = pool.size() * 4;
+
+    //one frame is written while the next is resampled
+    std::vector<unsigned char> inner, outer;
+    std::vector<unsigned char> frame_buffers[2];
+    frame_buffers[0].resize((size_t) width * height * 4);
+    frame_buffers[1].resize((size_t) width * height * 4);
+    std::future<bool> writing;
+    bool written = true;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int frame = 0;
+    double key_width = end_width * pow(2.0, keyframes - 1);
+    renderer.setView(center_x, center_y, key_width);
+
+    for (int key=keyframes - 1; key >= 0 && written; key--) {
+        renderer.generate();
+        outer.swap(inner);
+        inner.assign(renderer.getPixels(), renderer.getPixels() + (size_t) key_res_width * key_res_height * 4);
+
+        //every frame from here in to the next keyframe (the rest, on the last one)
+        for (; frame < frames; frame++) {
+            double t = frames > 1 ? (double) frame / (frames - 1) : 1;
+            double frame_width = start_width * pow(end_width / start_width, t);
+            if (key > 0 && frame_width < key_width) break;
+
+            std::vector<unsigned char> &pixels = frame_buffers[frame % 2];
+            std::vector< std::future<void> > done;
+            for (int n=0; n<jobs; n++) {
+                int first = height * n / jobs;
+                int rows = height * (n + 1) / jobs - first;
+                done.push_back(pool.submit([&, frame_width, first, rows]() {
+                    resample(pixels, frame_width, inner, outer, key_width,
+                             key_res_width, key_res_height, first, rows);
+                }));
+            }
+            for (unsigned int n=0; n<done.size(); n++) done[n].wait();
+
+            //wait for the last frame to be written before handing over this one
+            if (writing.valid()) written = writing.get() && written;
+            if (!written) break;
+            writing = std::async(std::launch::async, writeFrame, pattern, out, frame,
+                                 std::cref(pixels), width, height);
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << std::fixed << std::setprecision(1)
+                  << "Keyframe " << keyframes - key << "/" << keyframes << ", "
+                  << frame << "/" << frames << " frames, " << frame / elapsed << " frames/s" << std::endl;
+
+        if (key > 0) {
+            renderer.changePos(key_res_width/2.0, key_res_height/2.0, 0.5);
+            key_width /= 2;
+        }
+    }
+    if (writing.valid()) written = writing.get() && written;
+    return written && frame == frames;
+}
@@ -0,0 +1,71 @@
+#ifndef ZOOMMOVIE_H
+#define ZOOMMOVIE_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "highPrecision.h"
+
+//ZoomMovie renders a zoom into one point, from start_width down to end_width on
+//the complex plane, with the frames spaced evenly on a log scale. Only keyframes
+//are rendered: one at end_width and one at every doubling from there out. Each
+//frame lies between two keyframes, and is resampled from the inner one where it
+//covers the frame and from the outer one around it. The keyframes are rendered
+//a little bigger than the frames (key_scale), so the outer one is never
+//stretched much.
+class ZoomMovie {
+    public:
+        ZoomMovie(int width, int height, int frames);
+
+        //the path of the zoom: it ends centered on (x, y), end_width wide
+        void setView(const HighPrecision &x, const HighPrecision &y, double start_width, double end_width);
+        void setIterations(int iter) {iterations = iter;}
+        void setColorScheme(int newScheme) {scheme = newScheme;}
+        void setColorMultiple(double mult) {color_multiple = mult;}
+        void setRotation(double radians) {rotation = radians;}
+        void setThreads(unsigned int count) {threads = count;}
+        //how much bigger the keyframes are than the frames, 1 or more
+        void setKeyScale(double scale) {key_scale = scale;}
+
+        //writes every frame to its own image, named by putting the frame number
+        //into pattern with printf (frame%05d.png). Returns false without rendering
+        //anything if the pattern isn't one isFramePattern takes
+        bool renderFrames(const std::string &pattern);
+        //writes the frames to out one after another, as bare 8 bit RGB rows
+        bool renderVideo(FILE *out);
+
+        int getKeyframes() const;
+        //the size of the keyframes, which can't be over MandelbrotRenderer::max_resolution.
+        //render returns false without rendering anything if they are
+        int getKeyframeWidth() const;
+        int getKeyframeHeight() const;
+
+        //true if pattern has exactly one %d (or %Nd, %0Nd) for the frame number,
+        //and no other %, so it's safe to give to printf
+        static bool isFramePattern(const std::string &pattern);
+
+    private:
+        int width;
+        int height;
+        int frames;
+
+        HighPrecision center_x;
+        HighPrecision center_y;
+        double start_width;
+        double end_width;
+        int iterations;
+        int scheme;
+        double color_multiple;
+        double rotation;
+        unsigned int threads;
+        double key_scale;
+
+        bool render(const std::string &pattern, FILE *out);
+        //fills frame (RGBA) for a view frame_width wide, from the keyframe
+        //key_width wide and the one twice as wide (outer, empty if there isn't one)
+        void resample(std::vector<unsigned char> &frame, double frame_width,
+                      const std::vector<unsigned char> &inner, const std::vector<unsigned char> &outer,
+                      double key_width, int key_res_width, int key_res_height, int first_row, int rows);
+};
+
+#endif